@@ -68,6 +68,9 @@ public:
   llvm::Function* StringLookupFunction;
   
   llvm::Function* ResolveVirtualStubFunction;
+  llvm::Function* PromoteMethodFunction;
+  llvm::Function* InlineCacheMissFunction;
+  llvm::Function* StaticFieldBaseFunction;
   llvm::Function* ResolveSpecialStubFunction;
   llvm::Function* ResolveStaticStubFunction;
   llvm::Function* ResolveInterfaceFunction;
@@ -139,6 +142,8 @@ public:
   
   llvm::Constant* OffsetBaseClassInArrayClassConstant;
   llvm::Constant* OffsetLogSizeInPrimitiveClassConstant;
+
+  llvm::Constant* OffsetInvocationCountInJavaMethodConstant;
   
   llvm::Constant* ClassReadyConstant;
 
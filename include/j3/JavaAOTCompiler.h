@@ -101,7 +101,8 @@ private:
   llvm::Constant* CreateConstantFromJavaString(JavaString* str);
   llvm::Constant* CreateConstantForBaseObject(CommonClass* cl);
   llvm::Constant* CreateConstantFromJavaObject(JavaObject* obj);
-  llvm::Constant* CreateConstantFromClassBytes(ClassBytes* bytes);
+  llvm::Constant* CreateConstantFromClassBytes(ClassBytes* bytes,
+                                               llvm::GlobalVariable* GV);
   llvm::Constant* CreateConstantFromJavaConstantPool(JavaConstantPool* ctp);
   llvm::Constant* CreateConstantFromClassMap(const vmkit::VmkitDenseMap<const UTF8*, CommonClass*>& map);
   llvm::Constant* CreateConstantFromUTF8Map(const vmkit::VmkitDenseSet<vmkit::UTF8MapKey, const UTF8*>& set);
@@ -181,6 +182,7 @@ public:
   llvm::Function* JavaObjectTracer;
   llvm::Function* EmptyDestructorFunction;
   llvm::Function* ReferenceObjectTracer;
+  llvm::Function* NoReferenceObjectTracer;
   llvm::GlobalVariable* UTF8TombstoneGV;
   llvm::GlobalVariable* UTF8EmptyGV;
   
@@ -52,6 +52,11 @@ public:
     return 0;
   }
 
+  /// promoteMethod - Recompile a hot method with optimisations. Called once
+  /// the baseline code of the method has been executed often enough.
+  ///
+  virtual void promoteMethod(JavaMethod* meth) {}
+
   virtual bool isStaticCompiling() {
     return false;
   }
@@ -59,6 +59,38 @@ public:
   virtual void makeIMT(Class* cl);
   
   virtual void* materializeFunction(JavaMethod* meth, Class* customizeFor);
+
+  /// compileMethod - Compile the method with this compiler, in the current
+  /// thread.
+  ///
+  void* compileMethod(JavaMethod* meth, Class* customizeFor);
+
+  /// setNumberOfCompilerThreads - Set the number of threads compiling the
+  /// methods of the compilation queue. Zero compiles methods in the thread
+  /// that needs them.
+  ///
+  static void setNumberOfCompilerThreads(uint32 nb);
+
+  /// initialise - Handle the -X:jit: and -X:prof options of the command
+  /// line. Must be called by the launchers before creating the compiler.
+  ///
+  static void initialise(int argc, char** argv);
+
+  /// TieredCompilation - Whether methods are first compiled in the baseline
+  /// tier.
+  ///
+  static bool TieredCompilation;
+
+  virtual bool useTieredCompilation() {
+    return TieredCompilation && !isCompilingGarbageCollector();
+  }
+
+  virtual void promoteMethod(JavaMethod* meth);
+
+  /// optimiseMethod - Compile the method with all optimisations, in the
+  /// current thread, and redirect its baseline code to the new code.
+  ///
+  void optimiseMethod(JavaMethod* meth);
   
   virtual llvm::Constant* getFinalObject(JavaObject* obj, CommonClass* cl);
   virtual JavaObject* getFinalObject(llvm::Value* C);
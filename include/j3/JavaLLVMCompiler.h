@@ -14,6 +14,8 @@
 #include "j3/J3Intrinsics.h"
 #include "j3/LLVMInfo.h"
 
+#include "vmkit/Locks.h"
+
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
@@ -104,6 +106,20 @@ public:
     return TheModule->getContext();
   }
 
+  /// IRLock - Protects the IR of this compiler. Each compiler has its own
+  /// LLVM context and module, so different compilers can generate code in
+  /// parallel.
+  ///
+  vmkit::LockRecursive IRLock;
+
+  void protectIR() {
+    IRLock.lock();
+  }
+
+  void unprotectIR() {
+    IRLock.unlock();
+  }
+
   J3Intrinsics* getIntrinsics() {
     return &JavaIntrinsics;
   }
@@ -209,8 +225,28 @@ public:
   virtual void* materializeFunction(JavaMethod* meth,
                                     Class* customizeFor) = 0;
   llvm::Function* parseFunction(JavaMethod* meth, Class* customizeFor);
+
+  /// parseOptimisedFunction - Create a new function for the method, and
+  /// compile it with all optimisations. Used to replace the baseline code of
+  /// a hot method.
+  ///
+  llvm::Function* parseOptimisedFunction(JavaMethod* meth);
+
+  /// useTieredCompilation - Whether methods are first compiled in a baseline
+  /// tier, without optimisations, and recompiled once they are hot.
+  ///
+  virtual bool useTieredCompilation() {
+    return false;
+  }
+
+  /// InvocationThreshold - Number of invocations of baseline code after
+  /// which a method is promoted.
+  ///
+  static uint32 InvocationThreshold;
    
   llvm::FunctionPassManager* JavaFunctionPasses;
+  llvm::FunctionPassManager* JavaBaselineFunctionPasses;
+  llvm::FunctionPassManager* JavaOptimisingFunctionPasses;
   llvm::FunctionPassManager* J3FunctionPasses;
   llvm::FunctionPassManager* JavaNativeFunctionPasses;
   
@@ -89,13 +89,31 @@ private:
   
 public:
   llvm::Function* getMethod(Class* customizeFor);
+
+  /// createOptimisedMethod - Create a new function for the optimised code of
+  /// the method. The function of the method keeps the baseline code.
+  ///
+  llvm::Function* createOptimisedMethod();
+
+  /// isMethodFunction - Whether F is the function of the method, and not a
+  /// customized or optimised version of it.
+  ///
+  bool isMethodFunction(const llvm::Function* F) const {
+    return F == methodFunction;
+  }
+
   llvm::Constant* getOffset();
   llvm::FunctionType* getFunctionType();
   bool isCustomizable;
+
+  /// codeSize - The size of the code emitted for the function of the method,
+  /// i.e. of the baseline code with tiered compilation. Zero if unknown.
+  ///
+  size_t codeSize;
     
   LLVMMethodInfo(JavaMethod* M, JavaLLVMCompiler* comp) :  Compiler(comp),
     methodDef(M), methodFunction(0), offsetConstant(0), functionType(0),
-    isCustomizable(false) {}
+    isCustomizable(false), codeSize(0) {}
  
   virtual void clear() {
     methodFunction = 0;
@@ -103,6 +121,7 @@ public:
     functionType = 0;
     customizedVersions.clear();
     isCustomizable = false;
+    codeSize = 0;
   }
 
   void setCustomizedVersion(Class* customizeFor, llvm::Function* F);
@@ -37,6 +37,30 @@ namespace vmkit {
 
   static const uint32_t HashBits = 8;
   static const uint64_t GCBitMask = ((1 << GCBits) - 1);
+
+  // The identity hash of an object is derived from its address the first
+  // time it is requested, and the object is then in the HashedState. When a
+  // collector moves a hashed object, it appends a word holding the hash to
+  // the copy, which is then in the HashedAndMovedState.
+  static const uint64_t HashStateMask = 3 << GCBits;
+  static const uint64_t HashedState = 1 << GCBits;
+  static const uint64_t HashedAndMovedState = 2 << GCBits;
+
+  /// HashFromAddress - The 31-bit identity hash of an object at the given
+  /// address.
+  ///
+  static inline uint32_t HashFromAddress(word_t address) {
+    uint64_t val = (uint64_t)address >> 3;
+    val ^= val >> 31;
+    return (uint32_t)(val * 0x9E3779B1U) & 0x7FFFFFFF;
+  }
+
+  /// HashSlotOffset - The offset of the word holding the hash of a moved
+  /// object, given the size of the object.
+  ///
+  static inline size_t HashSlotOffset(size_t size) {
+    return (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+  }
 }
 
 #endif
@@ -31,6 +31,7 @@ namespace llvm {
   class ConstantInt;
   class ExecutionEngine;
   class Function;
+  class FunctionPass;
   class GCFunctionInfo;
   class GCStrategy;
   class JIT;
@@ -193,7 +194,42 @@ public:
 
    static void addCommandLinePasses(llvm::legacy::FunctionPassManager* PM);
 
+   /// addBaselinePasses - Add the passes run on baseline code: promotion of
+   /// locals to registers and cheap cleanups, so that compilation is as fast
+   /// as possible.
+   ///
+   static void addBaselinePasses(llvm::legacy::FunctionPassManager* PM);
+
+   /// addOptimisingPasses - Add the passes run on hot methods: the command
+   /// line passes, followed by more loop optimisations when the standard
+   /// compile passes are used. loopPass, if not null, is a VM specific pass
+   /// run once the loops have been rotated and their invariants hoisted.
+   ///
+   static void addOptimisingPasses(llvm::legacy::FunctionPassManager* PM,
+                                   llvm::FunctionPass* loopPass = NULL);
+
    static const char* getHostTriple();
+
+   /// EmitPerfMap - Write the address and name of compiled functions to
+   /// /tmp/perf-<pid>.map, where perf finds the symbols of JIT code.
+   ///
+   static bool EmitPerfMap;
+
+   /// openPerfMap - Create the perf map file. Called when the options are
+   /// parsed, before compiler threads start.
+   ///
+   static void openPerfMap();
+
+   /// EmitGDBSymbols - Register compiled functions with the JIT interface of
+   /// gdb.
+   ///
+   static bool EmitGDBSymbols;
+
+   /// registerCode - Publish the code of a compiled function to the tools
+   /// enabled by EmitPerfMap and EmitGDBSymbols. May be called by several
+   /// compiler threads at the same time.
+   ///
+   static void registerCode(const char* name, void* code, size_t size);
 };
 
 } // end namespace vmkit
@@ -158,12 +158,18 @@ public:
   SpinLock() { locked = 0; }
 
 
-  /// acquire - Acquire the spin lock, doing an active loop.
+  /// SpinLimit - Number of times acquire checks the lock before yielding.
+  ///
+  static const uint32 SpinLimit = 1000;
+
+  /// acquire - Acquire the spin lock, doing an active loop. The loop only
+  /// reads the lock while it is held, so that waiting threads do not keep
+  /// stealing its cache line from the owner.
   ///
   void acquire() {
-    for (uint32 count = 0; count < 1000; ++count) {
-      uint32 res = __sync_val_compare_and_swap(&locked, 0, 1);
-      if (!res) return;
+    for (uint32 count = 0; count < SpinLimit; ++count) {
+      if (!locked && !__sync_val_compare_and_swap(&locked, 0, 1)) return;
+      vmkit::System::SpinPause();
     }
     
     while (__sync_val_compare_and_swap(&locked, 0, 1))
@@ -77,8 +77,12 @@ public:
 class FatLock : public vmkit::PermanentObject {
 private:
   vmkit::LockRecursive internalLock;
-  vmkit::SpinLock spinLock;
   uint32_t waitingThreads;
+
+  /// lockingThreads - Number of threads in acquire. Threads increment it
+  /// atomically before reaching a GC point, so that the lock is never
+  /// deflated while a thread holds a pointer to it.
+  ///
   uint32_t lockingThreads;
   LockingThread* firstThread;
   gc* associatedObject;
@@ -86,6 +90,20 @@ private:
   FatLock* nextFreeLock;
   bool associatedObjectDead;
 
+  /// spinLimit - Number of times acquire checks whether the lock is free
+  /// before blocking. It grows when spinning gets the lock and shrinks when
+  /// it does not, so that threads only spin on locks held briefly.
+  ///
+  uint32_t spinLimit;
+
+  static const uint32_t MinSpinLimit = 16;
+  static const uint32_t MaxSpinLimit = 4096;
+
+  /// spin - Try to get the lock while its owner releases it. Returns true
+  /// if the lock was acquired.
+  ///
+  bool spin();
+
 public:
   FatLock(uint32_t index, gc* object);
   word_t getID();
@@ -162,6 +180,12 @@ public:
   }
 
   FatLock* getFatLockFromID(word_t ID);
+
+  /// deflateLocks - Turn the fat locks nobody holds, waits on, or tries to
+  /// acquire back into thin locks, and free them. Must be called while all
+  /// mutators are stopped, before the collector reads object headers.
+  ///
+  void deflateLocks();
 };
 
 class ThinLock {
@@ -174,6 +198,11 @@ public:
   //    ^      ^^^ ^^^^ ^^^^        ^^^^ ^^^^ ^^^^        ^^^^ ^^^^
   //    1           11                    12                  8
   // fat lock    thread id       thin lock count + hash     GC bits
+  //
+  // The two highest bits of the hash bits tell whether the lock is biased.
+  // The count takes the bits between the hash bits and the thread id, so it
+  // widens with the slots of the threads: 4 bits with 1MB slots, 7 bits with
+  // the 8MB slots of x64 (see kThreadSlotSize).
 
   static const uint64_t FatMask = 1LL << (kThreadStart > 0xFFFFFFFFLL ? 61LL : 31LL);
 
@@ -184,9 +213,31 @@ public:
   static const uint64_t ThinCountShift = NonLockBits;
   static const uint64_t ThinCountAdd = 1LL << NonLockBits;
 
-  /// initialise - Initialise the value of the lock.
+  /// BiasedMask - Set when the lock is biased towards the thread of the
+  /// thread id bits. The count bits then hold the number of times the thread
+  /// holds the lock, zero if it does not hold it. Only that thread changes
+  /// them, with a byte store, until the bias is revoked.
+  ///
+  static const uint64_t BiasedMask = 1LL << (NonLockBits - 1);
+
+  /// UnbiasableMask - Set once the bias of the lock has been revoked: the
+  /// lock is never biased again.
   ///
-  static void removeFatLock(FatLock* fatLock, LockSystem& table);
+  static const uint64_t UnbiasableMask = 1LL << (NonLockBits - 2);
+
+  /// BiasedCountByte - The offset in the header of the byte holding the
+  /// count bits.
+  ///
+#if ARCH_PPC
+  static const uint32_t BiasedCountByte = sizeof(word_t) - 1 - ThinCountShift / 8;
+#else
+  static const uint32_t BiasedCountByte = ThinCountShift / 8;
+#endif
+
+  /// SpinLimit - Number of times acquire checks whether a thin lock held by
+  /// another thread is free before yielding.
+  ///
+  static const uint32_t SpinLimit = 1000;
 
   /// overflowThinlock - Change the lock of this object to a fat lock because
   /// we have reached the maximum number of locks.
@@ -210,6 +261,12 @@ public:
 
   /// getFatLock - Get the fat lock is the lock is a fat lock, 0 otherwise.
   static FatLock* getFatLock(gc* object, LockSystem& table);
+
+  /// revokeBias - Turn a biased lock into a thin lock held the same number
+  /// of times by the same thread. Unless the current thread is the one the
+  /// lock is biased towards, all threads are stopped while the header is
+  /// rewritten.
+  static void revokeBias(gc* object, LockSystem& table);
 };
 
 } // end namespace vmkit
@@ -0,0 +1,58 @@
+//===------------- Profiler.h - Sampling profiler of VMKit ----------------===//
+//
+//                     The VMKit project
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef VMKIT_PROFILER_H
+#define VMKIT_PROFILER_H
+
+#include <cstddef>
+
+#include "vmkit/System.h"
+
+namespace vmkit {
+
+class VirtualMachine;
+
+/// Profiler - A sampling profiler of the CPU time. A timer sends SIGPROF to
+/// the threads consuming CPU, and the signal handler records the stack of
+/// VMKit threads into a lock-free buffer. A separate thread drains the
+/// buffer and aggregates the stacks of methods, which are written in the
+/// collapsed format of flame graphs, one "frame;frame;frame count" per line.
+///
+class Profiler {
+public:
+
+  /// Frequency - The number of samples per second of CPU time, 0 if the
+  /// profiler is disabled.
+  ///
+  static uint32_t Frequency;
+
+  /// OutputFile - The file to write the profile to. If null, the profile is
+  /// written to profile-<pid>.collapsed.
+  ///
+  static const char* OutputFile;
+
+  /// start - Start sampling the threads of the virtual machine. The profile
+  /// is also written when the process receives SIGUSR2.
+  ///
+  static void start(VirtualMachine* vm);
+
+  /// stop - Stop sampling and write the profile. Does nothing if the
+  /// profiler is not running.
+  ///
+  static void stop();
+
+  /// registerCode - Record the method of compiled code, to know which method
+  /// was executing when a sample is taken outside of a call.
+  ///
+  static void registerCode(void* code, size_t size, void* metadata);
+};
+
+} // end namespace vmkit
+
+#endif // VMKIT_PROFILER_H
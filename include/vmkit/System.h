@@ -11,6 +11,7 @@
 #define VMKIT_SYSTEM_H
 
 #include <csetjmp>
+#include <cstdlib>
 #include <cstring>
 #include <dlfcn.h>
 #include <signal.h>
@@ -60,13 +61,26 @@ namespace vmkit {
 const int kWordSize = sizeof(word_t);
 const int kWordSizeLog2 = kWordSize == 4 ? 2 : 3;
 
+// Threads live in the kVmkitThreadMask-aligned range starting at
+// kThreadStart. Each thread owns a kThreadSlotSize slot in that range, which
+// holds its thread local data and its stack. The slot size can be changed
+// with VMKIT_THREAD_SLOT_SIZE, a power of two of at most 16MB so that the
+// count of the thin locks fits in a byte (see ThinLock).
 #if ARCH_X64
-const word_t kThreadStart   = 0x0000000110000000LL;
-const word_t kThreadIDMask  = 0xFFFFFFFFFFF00000LL;
-const word_t kVmkitThreadMask = 0xFFFFFFFFF0000000LL;
+#ifndef VMKIT_THREAD_SLOT_SIZE
+#define VMKIT_THREAD_SLOT_SIZE 0x800000
+#endif
+const word_t kThreadStart   = 0x0000001000000000LL;
+const word_t kThreadSlotSize = VMKIT_THREAD_SLOT_SIZE;
+const word_t kThreadIDMask  = ~(kThreadSlotSize - 1);
+const word_t kVmkitThreadMask = 0xFFFFFFF000000000LL;
 #else
+#ifndef VMKIT_THREAD_SLOT_SIZE
+#define VMKIT_THREAD_SLOT_SIZE 0x100000
+#endif
 const word_t kThreadStart   = 0x10000000;
-const word_t kThreadIDMask  = 0x7FF00000;
+const word_t kThreadSlotSize = VMKIT_THREAD_SLOT_SIZE;
+const word_t kThreadIDMask  = 0x7FFFFFFF & ~(kThreadSlotSize - 1);
 const word_t kVmkitThreadMask = 0xF0000000;
 #endif
 
@@ -89,10 +103,20 @@ const word_t kVmkitThreadMask = 0xF0000000;
     const word_t kGCMemoryStart = 0x30000000;
   #endif
 #else
-  const word_t kGCMemoryStart = 0x50000000;
+  #if ARCH_X64
+    const word_t kGCMemoryStart = 0x200000000LL;
+  #else
+    const word_t kGCMemoryStart = 0x50000000;
+  #endif
 #endif
 
+// The GC memory range is only reserved at boot time. Memory is committed
+// on demand, when MMTk maps chunks of the heap.
+#if ARCH_X64
+const word_t kGCMemorySize = 0x800000000LL;
+#else
 const word_t kGCMemorySize = 0x30000000;
+#endif
 
 #define TRY { vmkit::ExceptionBuffer __buffer__; if (!SETJMP(__buffer__.buffer))
 #define CATCH else
@@ -156,6 +180,17 @@ public:
 #endif
   }
 
+  /// SpinPause - Tell the processor that the thread is busy-waiting, so that
+  /// it does not starve a sibling hardware thread.
+  ///
+  static void SpinPause() __attribute((always_inline)) {
+#if defined(ARCH_X86) || defined(ARCH_X64)
+    __asm__ __volatile__("pause" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+  }
+
   static word_t GetCallerOfAddress(word_t addr) {
     return ((word_t*)addr)[0];
   }
@@ -228,11 +263,32 @@ public:
 #endif
   }
 
+  // Parse a size with an optional k, m or g suffix, as given to -Xms, -Xmx
+  // or -Xss. Returns 0 if the size is malformed.
+  static size_t ParseMemorySize(const char* str) {
+    char* end = NULL;
+    size_t size = strtoull(str, &end, 10);
+    if (end == str) return 0;
+    switch (*end) {
+      case 'g': case 'G': size <<= 10;
+      case 'm': case 'M': size <<= 10;
+      case 'k': case 'K': size <<= 10; ++end;
+      default: break;
+    }
+    return (*end == 0) ? size : 0;
+  }
+
   static int GetNumberOfProcessors() {
     return sysconf(_SC_NPROCESSORS_ONLN);
   }
 
+  /// ExitHook - Called by Exit before the process terminates, e.g. to write
+  /// the profile of the application.
+  ///
+  static void (*ExitHook)();
+
   static void Exit(int value) {
+    if (ExitHook != NULL) ExitHook();
     _exit(value);
   }
 
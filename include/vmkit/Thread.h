@@ -117,6 +117,7 @@ public:
   Thread() {
     lastExceptionBuffer = 0;
     lastKnownFrame = 0;
+    stackSize = 0;
   }
 
   /// yield - Yield the processor to another thread.
@@ -232,9 +233,9 @@ public:
 
   /// OverflowMask - Apply this mask to implement overflow checks. For
   /// efficiency, we lower the available size of the stack: it can never go
-  /// under 0xC0000
+  /// under the lowest 256KB of the slot of the thread.
   ///
-  static const uint64_t StackOverflowMask = 0xC0000;
+  static const uint64_t StackOverflowMask = (kThreadSlotSize - 1) & ~0x3FFFFLL;
 
   /// stackOverflow - Returns if there is a stack overflow in Java land.
   ///
@@ -243,9 +244,10 @@ public:
   }
 
   /// operator new - Allocate the Thread object as well as the stack for this
-  /// Thread. The thread object is inlined in the stack.
+  /// Thread. The thread object is inlined in the stack. Returns NULL if all
+  /// stacks are in use.
   ///
-  void* operator new(size_t sz);
+  void* operator new(size_t sz) throw();
   void operator delete(void* th) { UNREACHABLE(); }
   
   /// releaseThread - Free the stack so that another thread can use it.
@@ -276,6 +278,29 @@ public:
   ///
   ExceptionBuffer* lastExceptionBuffer;
 
+  /// stackSize - The size of the stack of this thread, thread local data
+  /// included. Zero means DefaultStackSize.
+  ///
+  word_t stackSize;
+
+  /// DefaultStackSize - The stack size of threads that do not ask for a
+  /// specific size. Set by -Xss.
+  ///
+  static word_t DefaultStackSize;
+
+  /// MaxStackSize - The largest stack a thread can have: the size of its
+  /// slot in the range reserved for threads.
+  ///
+  static const word_t MaxStackSize;
+
+  /// setStackSize - Set the stack size of the thread. Must be called before
+  /// the thread is started. The size is rounded to what the stack of a
+  /// thread can hold.
+  ///
+  void setStackSize(word_t size) {
+    stackSize = size;
+  }
+
   void internalThrowException();
 
   void startKnownFrame(KnownFrame& F) __attribute__ ((noinline));
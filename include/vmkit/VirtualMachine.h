@@ -20,6 +20,7 @@
 #include "vmkit/GC.h"
 
 #include <cassert>
+#include <cstdio>
 #include <map>
 
 namespace vmkit {
@@ -28,15 +29,39 @@ class CompiledFrames;
 class FrameInfo;
 class Frames;
 
+/// FrameInfoTable - Open addressed hash table of FrameInfo, keyed by their
+/// return address, with linear probing.
+///
+class FrameInfoTable {
+public:
+  /// Capacity - The number of entries, a power of two.
+  ///
+  uint32_t Capacity;
+
+  /// Next - The previous tables, that readers may still be using.
+  ///
+  FrameInfoTable* Next;
+
+  FrameInfo* volatile Entries[1];
+
+  static FrameInfoTable* create(uint32_t capacity);
+};
+
 class FunctionMap {
 public:
   /// Functions - Map of applicative methods to function pointers. This map is
   /// used when walking the stack so that VMKit knows which applicative method
-  /// is executing on the stack.
+  /// is executing on the stack. Readers do not lock: writers fill the table
+  /// in place, or publish a bigger copy of it.
+  ///
+  FrameInfoTable* volatile Functions;
+
+  /// NumFunctions - The number of entries in the Functions table.
   ///
-  llvm::DenseMap<word_t, FrameInfo*> Functions;
+  uint32_t NumFunctions;
 
-  /// FunctionMapLock - Spin lock to protect the Functions map.
+  /// FunctionMapLock - Spin lock to serialize the writers of the Functions
+  /// map.
   ///
   vmkit::SpinLock FunctionMapLock;
 
@@ -47,13 +72,18 @@ public:
   /// addFrameInfo - A new instruction pointer in the function map.
   ///
   void addFrameInfo(word_t ip, FrameInfo* meth);
-  void addFrameInfoNoLock(word_t ip, FrameInfo* meth) {
-    Functions[ip] = meth;
-  }
+  void addFrameInfoNoLock(word_t ip, FrameInfo* meth);
+
   /// removeFrameInfos - Remove all FrameInfo owned by the given owner.
   void removeFrameInfos(void* owner) {} /* TODO */
 
   FunctionMap(BumpPtrAllocator& allocator, CompiledFrames** frames);
+
+private:
+  /// grow - Publish a copy of the Functions table twice as big. The old
+  /// table is retired but not freed, since readers may still probe it.
+  ///
+  void grow();
 };
 
 /// VirtualMachine - This class is the root of virtual machine classes. It
@@ -159,6 +189,11 @@ public:
   ///
   virtual void startCollection() {}
   
+  /// mutatorsStopped - Code run once all mutators are stopped for a GC,
+  /// before the collector starts.
+  ///
+  virtual void mutatorsStopped() {}
+
   /// endCollection - Code after running a GC.
   ///
   virtual void endCollection() {}
@@ -245,6 +280,13 @@ public:
   }
 
   virtual void printMethod(FrameInfo* FI, word_t ip, word_t addr) = 0;
+
+  /// getMethodName - Write the name of the method described by the metadata
+  /// of a frame in the buffer, for profiles.
+  ///
+  virtual void getMethodName(void* metadata, char* buffer, size_t size) {
+    snprintf(buffer, size, "%p", metadata);
+  }
   
 //===----------------------------------------------------------------------===//
 // (4) Launch-related methods.
@@ -286,6 +328,20 @@ public:
   /// setObjectReferent - set the referent of an object
   ///
   virtual void setObjectReferent(gc* _obj, gc* val) {}
+
+//===----------------------------------------------------------------------===//
+// (7) Lock-related methods.
+//===----------------------------------------------------------------------===//
+
+  /// isBiasable - Returns false if the lock of this object must not be biased
+  /// towards the first thread that takes it.
+  ///
+  virtual bool isBiasable(gc* object) { return true; }
+
+  /// biasRevoked - Called after the bias of the lock of this object had to be
+  /// revoked while held by another thread.
+  ///
+  virtual void biasRevoked(gc* object) {}
 };
 
 
@@ -539,6 +539,20 @@ extern "C" void nativeJavaObjectVMThreadTracer(
   JavaObjectVMThread::staticTracer(obj, closure);
 }
 
+extern "C" JavaString* Java_java_lang_VMString_intern__Ljava_lang_String_2(JavaString* str) {
+  JavaString* res = 0;
+  llvm_gcroot(str, 0);
+  llvm_gcroot(res, 0);
+
+  BEGIN_NATIVE_EXCEPTION(0)
+
+  res = JavaThread::get()->getJVM()->internString(str);
+
+  END_NATIVE_EXCEPTION
+
+  return res;
+}
+
 extern "C" JavaString* Java_java_lang_VMSystem_getenv__Ljava_lang_String_2(JavaString* str) {
   JavaString* ret = 0;
   llvm_gcroot(str, 0);
@@ -819,6 +833,7 @@ void Classpath::initialiseClasspath(JnjvmClassLoader* loader) {
   internString =
     UPCALL_METHOD(loader, "java/lang/VMString", "intern",
                   "(Ljava/lang/String;)Ljava/lang/String;", ACC_STATIC); 
+  internString->setNative();
   
   JavaMethod* isArray =
     UPCALL_METHOD(loader, "java/lang/Class", "isArray", "()Z", ACC_VIRTUAL);
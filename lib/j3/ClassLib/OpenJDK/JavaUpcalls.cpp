@@ -42,6 +42,7 @@ JavaMethod* Classpath::initNamedGroup;
 JavaField*  Classpath::priority;
 JavaField*  Classpath::daemon;
 JavaField*  Classpath::eetop;
+JavaField*  Classpath::stackSize;
 JavaField*  Classpath::threadStatus;
 JavaField*  Classpath::group;
 Class*      Classpath::threadGroup;
@@ -481,6 +482,20 @@ extern "C" void Java_java_lang_ref_Reference__0003Cclinit_0003E() {
   END_NATIVE_EXCEPTION
 }
 
+extern "C" JavaString* Java_java_lang_VMString_intern__Ljava_lang_String_2(JavaString* str) {
+  JavaString* res = 0;
+  llvm_gcroot(str, 0);
+  llvm_gcroot(res, 0);
+
+  BEGIN_NATIVE_EXCEPTION(0)
+
+  res = JavaThread::get()->getJVM()->internString(str);
+
+  END_NATIVE_EXCEPTION
+
+  return res;
+}
+
 extern "C" void nativeJavaObjectClassTracer(
     JavaObjectClass* obj, word_t closure) {
   llvm_gcroot(obj, 0);
@@ -849,6 +864,9 @@ void Classpath::initialiseClasspath(JnjvmClassLoader* loader) {
   eetop =
     UPCALL_FIELD(loader, "java/lang/Thread", "eetop", "J", ACC_VIRTUAL);
 
+  stackSize =
+    UPCALL_FIELD(loader, "java/lang/Thread", "stackSize", "J", ACC_VIRTUAL);
+
   threadStatus =
     UPCALL_FIELD(loader, "java/lang/Thread", "threadStatus", "I", ACC_VIRTUAL);
   group =
@@ -1015,6 +1033,7 @@ void Classpath::initialiseClasspath(JnjvmClassLoader* loader) {
   internString =
     UPCALL_METHOD(loader, "java/lang/VMString", "intern",
         "(Ljava/lang/String;)Ljava/lang/String;", ACC_STATIC);
+  internString->setNative();
 }
 
 void Classpath::InitializeSystem(Jnjvm * jvm) {
@@ -155,6 +155,7 @@ public:
   ISOLATE_STATIC JavaField* priority;
   ISOLATE_STATIC JavaField* daemon;
   ISOLATE_STATIC JavaField* eetop;
+  ISOLATE_STATIC JavaField* stackSize;
   ISOLATE_STATIC JavaField* group;
   ISOLATE_STATIC JavaField* threadStatus;
   ISOLATE_STATIC UserClass* threadGroup;
@@ -0,0 +1,385 @@
+//===--- ArrayBoundsCheckElimination.cpp - Remove bounds checks in loops ---===//
+//
+//                            The VMKit project
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass removes the array bounds checks of innermost loops whose index is
+// an induction variable. The loop is versioned: a single check before the
+// loop verifies that the arrays are not null and that the first and the last
+// values of each index are within the bounds of their array. If it succeeds,
+// a copy of the loop without the bounds checks is executed, otherwise the
+// original loop, which throws the exception at the right iteration.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpander.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/SSAUpdater.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+#include <vector>
+
+#include "j3/JavaLLVMCompiler.h"
+#include "j3/J3Intrinsics.h"
+
+using namespace llvm;
+
+namespace j3 {
+
+/// BoundsCheck - A bounds check of a loop, and the range of its index.
+///
+struct BoundsCheck {
+  BranchInst* Branch;
+  BasicBlock* InBounds;
+  Value* Array;
+  const SCEVAddRecExpr* Index;
+  Value* First;
+  Value* Last;
+};
+
+/// VersionedLoop - A loop whose bounds checks are removed.
+///
+struct VersionedLoop {
+  Loop* L;
+  BasicBlock* Preheader;
+  std::vector<BoundsCheck> Checks;
+};
+
+class ArrayBoundsCheckElimination : public FunctionPass {
+public:
+  static char ID;
+  JavaLLVMCompiler* TheCompiler;
+  ArrayBoundsCheckElimination(JavaLLVMCompiler* Compiler) : FunctionPass(ID),
+    TheCompiler(Compiler) { }
+
+  const char* getPassName() const { return "Array bounds check elimination"; }
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.addRequired<LoopInfo>();
+    AU.addRequired<ScalarEvolution>();
+  }
+
+  virtual bool runOnFunction(Function &F);
+
+private:
+  J3Intrinsics* intrinsics;
+  ScalarEvolution* SE;
+
+  /// MaxLoopSize - Number of instructions above which a loop is not copied.
+  ///
+  static const unsigned MaxLoopSize = 512;
+
+  bool isBoundsCheck(BranchInst* BI, Value*& Index, Value*& Array,
+                     BasicBlock*& InBounds);
+  bool analyseLoop(Loop* L, VersionedLoop& V);
+  void versionLoop(Function& F, VersionedLoop& V);
+};
+char ArrayBoundsCheckElimination::ID = 0;
+
+static void collectInnermostLoops(Loop* L, std::vector<Loop*>& Loops) {
+  if (L->empty()) {
+    Loops.push_back(L);
+    return;
+  }
+  for (Loop::iterator I = L->begin(), E = L->end(); I != E; ++I) {
+    collectInnermostLoops(*I, Loops);
+  }
+}
+
+// verifyAndComputePtr emits "br (icmp ult index, arrayLength(array))" whose
+// false destination throws an ArrayIndexOutOfBoundsException. The passes
+// before may have inverted the comparison.
+bool ArrayBoundsCheckElimination::isBoundsCheck(BranchInst* BI, Value*& Index,
+                                                Value*& Array,
+                                                BasicBlock*& InBounds) {
+  if (!BI->isConditional()) return false;
+  ICmpInst* Cmp = dyn_cast<ICmpInst>(BI->getCondition());
+  if (!Cmp) return false;
+
+  ICmpInst::Predicate Pred = Cmp->getPredicate();
+  Value* LHS = Cmp->getOperand(0);
+  Value* RHS = Cmp->getOperand(1);
+  CallInst* Size = dyn_cast<CallInst>(RHS);
+  if (!Size || Size->getCalledValue() != intrinsics->ArrayLengthFunction) {
+    Size = dyn_cast<CallInst>(LHS);
+    if (!Size || Size->getCalledValue() != intrinsics->ArrayLengthFunction) {
+      return false;
+    }
+    std::swap(LHS, RHS);
+    Pred = ICmpInst::getSwappedPredicate(Pred);
+  }
+
+  BasicBlock* OutOfBounds = NULL;
+  if (Pred == ICmpInst::ICMP_ULT) {
+    InBounds = BI->getSuccessor(0);
+    OutOfBounds = BI->getSuccessor(1);
+  } else if (Pred == ICmpInst::ICMP_UGE) {
+    InBounds = BI->getSuccessor(1);
+    OutOfBounds = BI->getSuccessor(0);
+  } else {
+    return false;
+  }
+
+  for (BasicBlock::iterator I = OutOfBounds->begin(), E = OutOfBounds->end();
+       I != E; ++I) {
+    if (CallInst* CI = dyn_cast<CallInst>(I)) {
+      if (CI->getCalledValue() == intrinsics->IndexOutOfBoundsExceptionFunction) {
+        Index = LHS;
+        Array = Size->getArgOperand(0);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool ArrayBoundsCheckElimination::analyseLoop(Loop* L, VersionedLoop& V) {
+  BasicBlock* Preheader = L->getLoopPreheader();
+  BasicBlock* Latch = L->getLoopLatch();
+  if (!Preheader || !Latch || !L->isLoopExiting(Latch)) return false;
+
+  // The number of times the back edge is taken before the latch exits the
+  // loop. The loop may exit before through other exits, so this is an upper
+  // bound of the number of iterations.
+  const SCEV* Count = SE->getExitCount(L, Latch);
+  if (isa<SCEVCouldNotCompute>(Count) ||
+      SE->getTypeSizeInBits(Count->getType()) > 32) {
+    return false;
+  }
+
+  unsigned Size = 0;
+  for (Loop::block_iterator BI = L->block_begin(), BE = L->block_end();
+       BI != BE; ++BI) {
+    BasicBlock* BB = *BI;
+    Size += BB->size();
+    if (Size > MaxLoopSize) return false;
+
+    BranchInst* Branch = dyn_cast<BranchInst>(BB->getTerminator());
+    if (!Branch) continue;
+
+    Value* Index = NULL;
+    Value* Array = NULL;
+    BasicBlock* InBounds = NULL;
+    if (!isBoundsCheck(Branch, Index, Array, InBounds)) continue;
+    if (!L->isLoopInvariant(Array)) continue;
+    if (!SE->isSCEVable(Index->getType()) ||
+        SE->getTypeSizeInBits(Index->getType()) > 32) {
+      continue;
+    }
+
+    const SCEVAddRecExpr* AR = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(Index));
+    if (!AR || AR->getLoop() != L || !AR->isAffine()) continue;
+    const SCEVConstant* Step =
+      dyn_cast<SCEVConstant>(AR->getStepRecurrence(*SE));
+    if (!Step) continue;
+    if (!isSafeToExpand(AR->getStart(), *SE)) continue;
+
+    BoundsCheck Check;
+    Check.Branch = Branch;
+    Check.InBounds = InBounds;
+    Check.Array = Array;
+    Check.Index = AR;
+    Check.First = NULL;
+    Check.Last = NULL;
+    V.Checks.push_back(Check);
+  }
+
+  if (V.Checks.empty() || !isSafeToExpand(Count, *SE)) return false;
+
+  // Compute the first and the last values of the indexes in 64 bits: if an
+  // index wraps around in 32 bits, its range goes beyond the bounds of any
+  // array and the loop with the checks is executed.
+  Type* LongTy = intrinsics->constantLongZero->getType();
+  SCEVExpander Expander(*SE, "bounds");
+  const SCEV* LongCount = SE->getZeroExtendExpr(Count, LongTy);
+  Instruction* InsertPt = Preheader->getTerminator();
+  for (std::vector<BoundsCheck>::iterator I = V.Checks.begin(),
+       E = V.Checks.end(); I != E; ++I) {
+    const SCEV* Start = SE->getSignExtendExpr(I->Index->getStart(), LongTy);
+    const SCEV* Step = SE->getSignExtendExpr(I->Index->getStepRecurrence(*SE),
+                                             LongTy);
+    const SCEV* End = SE->getAddExpr(Start, SE->getMulExpr(Step, LongCount));
+    I->First = Expander.expandCodeFor(Start, LongTy, InsertPt);
+    I->Last = Expander.expandCodeFor(End, LongTy, InsertPt);
+  }
+
+  V.L = L;
+  V.Preheader = Preheader;
+  return true;
+}
+
+void ArrayBoundsCheckElimination::versionLoop(Function& F, VersionedLoop& V) {
+  LLVMContext& Context = F.getContext();
+  Loop* L = V.L;
+  BasicBlock* Header = L->getHeader();
+  BasicBlock* Preheader = V.Preheader;
+
+  BasicBlock* NullCheck = BasicBlock::Create(Context, "bounds null check", &F);
+  BasicBlock* RangeCheck = BasicBlock::Create(Context, "bounds range check", &F);
+  BasicBlock* Checked = BasicBlock::Create(Context, "bounds checked loop", &F);
+
+  Preheader->getTerminator()->replaceUsesOfWith(Header, NullCheck);
+  for (BasicBlock::iterator I = Header->begin(); isa<PHINode>(I); ++I) {
+    PHINode* PN = cast<PHINode>(I);
+    PN->setIncomingBlock(PN->getBasicBlockIndex(Preheader), RangeCheck);
+  }
+
+  // The copy of the loop keeps the bounds checks.
+  ValueToValueMapTy VMap;
+  std::vector<BasicBlock*> Blocks(L->block_begin(), L->block_end());
+  std::vector<BasicBlock*> NewBlocks;
+  for (std::vector<BasicBlock*>::iterator I = Blocks.begin(),
+       E = Blocks.end(); I != E; ++I) {
+    BasicBlock* NewBB = CloneBasicBlock(*I, VMap, ".checked", &F);
+    VMap[*I] = NewBB;
+    NewBlocks.push_back(NewBB);
+  }
+  for (std::vector<BasicBlock*>::iterator I = NewBlocks.begin(),
+       E = NewBlocks.end(); I != E; ++I) {
+    for (BasicBlock::iterator II = (*I)->begin(), IE = (*I)->end();
+         II != IE; ++II) {
+      RemapInstruction(II, VMap,
+                       RF_NoModuleLevelChanges | RF_IgnoreMissingEntries);
+    }
+  }
+  BasicBlock* NewHeader = cast<BasicBlock>(VMap[Header]);
+  for (BasicBlock::iterator I = NewHeader->begin(); isa<PHINode>(I); ++I) {
+    PHINode* PN = cast<PHINode>(I);
+    PN->setIncomingBlock(PN->getBasicBlockIndex(RangeCheck), Checked);
+  }
+  BranchInst::Create(NewHeader, Checked);
+
+  // Check that the arrays are not null, and then that the indexes are in
+  // their bounds.
+  Value* NotNull = ConstantInt::getTrue(Context);
+  Value* InRange = ConstantInt::getTrue(Context);
+  Type* LongTy = intrinsics->constantLongZero->getType();
+  for (std::vector<BoundsCheck>::iterator I = V.Checks.begin(),
+       E = V.Checks.end(); I != E; ++I) {
+    Value* Cmp = new ICmpInst(*NullCheck, ICmpInst::ICMP_NE, I->Array,
+                              intrinsics->JavaObjectNullConstant, "");
+    NotNull = BinaryOperator::CreateAnd(NotNull, Cmp, "", NullCheck);
+
+    Value* Size = CallInst::Create(intrinsics->ArrayLengthFunction, I->Array,
+                                   "", RangeCheck);
+    Size = new SExtInst(Size, LongTy, "", RangeCheck);
+    Value* Low = I->First;
+    Value* High = I->Last;
+    if (SE->isKnownNegative(I->Index->getStepRecurrence(*SE))) {
+      std::swap(Low, High);
+    }
+    Cmp = new ICmpInst(*RangeCheck, ICmpInst::ICMP_SGE, Low,
+                       intrinsics->constantLongZero, "");
+    InRange = BinaryOperator::CreateAnd(InRange, Cmp, "", RangeCheck);
+    Cmp = new ICmpInst(*RangeCheck, ICmpInst::ICMP_SLT, High, Size, "");
+    InRange = BinaryOperator::CreateAnd(InRange, Cmp, "", RangeCheck);
+  }
+  BranchInst::Create(RangeCheck, Checked, NotNull, NullCheck);
+  BranchInst::Create(Header, Checked, InRange, RangeCheck);
+
+  // The exits of the loop are now also reached from the copy.
+  SmallVector<BasicBlock*, 8> ExitBlocks;
+  L->getUniqueExitBlocks(ExitBlocks);
+  for (SmallVector<BasicBlock*, 8>::iterator I = ExitBlocks.begin(),
+       E = ExitBlocks.end(); I != E; ++I) {
+    for (BasicBlock::iterator II = (*I)->begin(); isa<PHINode>(II); ++II) {
+      PHINode* PN = cast<PHINode>(II);
+      unsigned NumIncoming = PN->getNumIncomingValues();
+      for (unsigned i = 0; i < NumIncoming; ++i) {
+        BasicBlock* Pred = PN->getIncomingBlock(i);
+        if (!L->contains(Pred)) continue;
+        Value* Val = PN->getIncomingValue(i);
+        ValueToValueMapTy::iterator It = VMap.find(Val);
+        if (It != VMap.end()) Val = It->second;
+        PN->addIncoming(Val, cast<BasicBlock>(VMap[Pred]));
+      }
+    }
+  }
+
+  // Other uses of the values of the loop now see either the value of the
+  // loop or the value of its copy.
+  for (std::vector<BasicBlock*>::iterator I = Blocks.begin(),
+       E = Blocks.end(); I != E; ++I) {
+    for (BasicBlock::iterator II = (*I)->begin(), IE = (*I)->end();
+         II != IE; ++II) {
+      Instruction* Inst = II;
+      SmallVector<Use*, 8> Uses;
+      for (Value::use_iterator UI = Inst->use_begin(), UE = Inst->use_end();
+           UI != UE; ++UI) {
+        Use& U = *UI;
+        Instruction* User = cast<Instruction>(U.getUser());
+        BasicBlock* UseBB = User->getParent();
+        if (PHINode* PN = dyn_cast<PHINode>(User)) {
+          UseBB = PN->getIncomingBlock(U);
+        }
+        if (L->contains(UseBB)) continue;
+        Uses.push_back(&U);
+      }
+      if (Uses.empty()) continue;
+
+      Instruction* NewInst = cast<Instruction>(VMap[Inst]);
+      SSAUpdater Updater;
+      Updater.Initialize(Inst->getType(), Inst->getName());
+      Updater.AddAvailableValue(Inst->getParent(), Inst);
+      Updater.AddAvailableValue(NewInst->getParent(), NewInst);
+      for (SmallVector<Use*, 8>::iterator UI = Uses.begin(),
+           UE = Uses.end(); UI != UE; ++UI) {
+        Updater.RewriteUse(**UI);
+      }
+    }
+  }
+
+  // Finally, remove the bounds checks of the original loop.
+  for (std::vector<BoundsCheck>::iterator I = V.Checks.begin(),
+       E = V.Checks.end(); I != E; ++I) {
+    BranchInst* Branch = I->Branch;
+    Branch->setCondition(Branch->getSuccessor(0) == I->InBounds ?
+                         ConstantInt::getTrue(Context) :
+                         ConstantInt::getFalse(Context));
+  }
+}
+
+bool ArrayBoundsCheckElimination::runOnFunction(Function& F) {
+  intrinsics = TheCompiler->getIntrinsics();
+  SE = &getAnalysis<ScalarEvolution>();
+  LoopInfo* LI = &getAnalysis<LoopInfo>();
+
+  std::vector<Loop*> Loops;
+  for (LoopInfo::iterator I = LI->begin(), E = LI->end(); I != E; ++I) {
+    collectInnermostLoops(*I, Loops);
+  }
+
+  // Analyse all loops before changing the control flow: the analyses are
+  // not updated when a loop is copied.
+  std::vector<VersionedLoop> Versioned;
+  for (std::vector<Loop*>::iterator I = Loops.begin(), E = Loops.end();
+       I != E; ++I) {
+    VersionedLoop V;
+    if (analyseLoop(*I, V)) Versioned.push_back(V);
+  }
+
+  for (std::vector<VersionedLoop>::iterator I = Versioned.begin(),
+       E = Versioned.end(); I != E; ++I) {
+    versionLoop(F, *I);
+  }
+  return !Versioned.empty();
+}
+
+
+FunctionPass* createArrayBoundsCheckEliminationPass(JavaLLVMCompiler* Compiler) {
+  return new ArrayBoundsCheckElimination(Compiler);
+}
+
+}
@@ -166,6 +166,8 @@ void J3Intrinsics::init(llvm::Module* module) {
   OffsetJNIInJavaThreadConstant =           ConstantInt::get(Type::getInt32Ty(Context), 1);
   OffsetJavaExceptionInJavaThreadConstant = ConstantInt::get(Type::getInt32Ty(Context), 2);
 
+  OffsetInvocationCountInJavaMethodConstant = ConstantInt::get(Type::getInt32Ty(Context), 10);
+
   ClassReadyConstant = ConstantInt::get(Type::getInt8Ty(Context), ready);
   
   InterfaceLookupFunction = module->getFunction("j3InterfaceLookup");
@@ -212,6 +214,9 @@ void J3Intrinsics::init(llvm::Module* module) {
   ResolveVirtualStubFunction = module->getFunction("j3ResolveVirtualStub");
   ResolveStaticStubFunction = module->getFunction("j3ResolveStaticStub");
   ResolveSpecialStubFunction = module->getFunction("j3ResolveSpecialStub");
+  PromoteMethodFunction = module->getFunction("j3PromoteMethod");
+  InlineCacheMissFunction = module->getFunction("j3InlineCacheMiss");
+  StaticFieldBaseFunction = module->getFunction("j3StaticFieldBase");
   ResolveInterfaceFunction = module->getFunction("j3ResolveInterface");
   
   NullPointerExceptionFunction =
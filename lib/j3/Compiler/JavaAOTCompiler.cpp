@@ -279,14 +279,17 @@ Constant* JavaAOTCompiler::getClassBytes(const UTF8* className, ClassBytes* byte
   std::vector<Type*> Elemts;
   ArrayType* ATy = ArrayType::get(Type::getInt8Ty(getLLVMContext()), bytes->size);
   Elemts.push_back(Type::getInt32Ty(getLLVMContext()));
+  Elemts.push_back(PointerType::getUnqual(Type::getInt8Ty(getLLVMContext())));
   Elemts.push_back(ATy);
   StructType* STy = StructType::get(getLLVMContext(), Elemts);
 
   std::string name(UTF8Buffer(className).toCompileName("_bytes")->cString());
-  Constant* C = emitClassBytes ? CreateConstantFromClassBytes(bytes) : NULL;
   GlobalVariable* varGV = new GlobalVariable(*getLLVMModule(), STy, false,
                                              GlobalValue::ExternalLinkage,
-                                             C, name);
+                                             NULL, name);
+  if (emitClassBytes) {
+    varGV->setInitializer(CreateConstantFromClassBytes(bytes, varGV));
+  }
   classBytes[bytes] = varGV;
   return varGV;
 }
@@ -867,7 +870,8 @@ Constant* JavaAOTCompiler::CreateConstantFromCommonClass(CommonClass* cl) {
   CommonClassElts.push_back(ConstantArray::get(ATy, TCM));
   
   // access
-  CommonClassElts.push_back(ConstantInt::get(Type::getInt32Ty(getLLVMContext()), cl->access));
+  CommonClassElts.push_back(ConstantInt::get(Type::getInt32Ty(getLLVMContext()),
+                                             cl->access & ~JNJVM_UNBIASABLE));
  
   // interfaces
   if (cl->nbInterfaces) {
@@ -1033,6 +1037,15 @@ Constant* JavaAOTCompiler::CreateConstantFromJavaMethod(JavaMethod& method) {
   // offset
   MethodElts.push_back(ConstantInt::get(Type::getInt32Ty(getLLVMContext()), method.offset));
 
+  // invocationCount
+  MethodElts.push_back(Constant::getNullValue(Type::getInt32Ty(getLLVMContext())));
+
+  // promoted
+  MethodElts.push_back(Constant::getNullValue(Type::getInt32Ty(getLLVMContext())));
+
+  // inlineCaches
+  MethodElts.push_back(Constant::getNullValue(JavaIntrinsics.ptrType));
+
   return ConstantStruct::get(STy, MethodElts); 
 }
 
@@ -1393,19 +1406,55 @@ Constant* JavaAOTCompiler::CreateConstantFromClass(Class* cl) {
   // minJDKVersionBuild
   ClassElts.push_back(ConstantInt::get(Type::getInt16Ty(getLLVMContext()), cl->minJDKVersionBuild));
 
+  // nbReferenceOffsets
+  ClassElts.push_back(ConstantInt::get(Type::getInt32Ty(getLLVMContext()), cl->nbReferenceOffsets));
+
+  // referenceOffsets
+  Type* OffsetsTy = PointerType::getUnqual(Type::getInt32Ty(getLLVMContext()));
+  if (cl->nbReferenceOffsets) {
+    ATy = ArrayType::get(Type::getInt32Ty(getLLVMContext()),
+                         cl->nbReferenceOffsets);
+    for (uint32 i = 0; i < cl->nbReferenceOffsets; ++i) {
+      TempElts.push_back(ConstantInt::get(Type::getInt32Ty(getLLVMContext()),
+                                          cl->referenceOffsets[i]));
+    }
+    Constant* offsets = ConstantArray::get(ATy, TempElts);
+    TempElts.clear();
+    offsets = new GlobalVariable(*getLLVMModule(), ATy, true,
+                                 GlobalValue::InternalLinkage,
+                                 offsets, "");
+    ClassElts.push_back(ConstantExpr::getCast(Instruction::BitCast, offsets,
+                                              OffsetsTy));
+  } else {
+    ClassElts.push_back(Constant::getNullValue(OffsetsTy));
+  }
+
+  // biasRevocations
+  ClassElts.push_back(ConstantInt::get(Type::getInt32Ty(getLLVMContext()), 0));
+
   return ConstantStruct::get(STy, ClassElts);
 }
 
-Constant* JavaAOTCompiler::CreateConstantFromClassBytes(ClassBytes* bytes) {
+Constant* JavaAOTCompiler::CreateConstantFromClassBytes(ClassBytes* bytes,
+                                                        GlobalVariable* GV) {
   std::vector<Type*> Elemts;
   ArrayType* ATy = ArrayType::get(Type::getInt8Ty(getLLVMContext()), bytes->size);
   Elemts.push_back(Type::getInt32Ty(getLLVMContext()));
+  Elemts.push_back(PointerType::getUnqual(Type::getInt8Ty(getLLVMContext())));
   Elemts.push_back(ATy);
 
   StructType* STy = StructType::get(getLLVMContext(), Elemts);
   
   std::vector<Constant*> Cts;
   Cts.push_back(ConstantInt::get(Type::getInt32Ty(getLLVMContext()), bytes->size));
+
+  // The elements follow the header.
+  Constant* GEPs[3] = {
+    ConstantInt::get(Type::getInt32Ty(getLLVMContext()), 0),
+    ConstantInt::get(Type::getInt32Ty(getLLVMContext()), 2),
+    ConstantInt::get(Type::getInt32Ty(getLLVMContext()), 0)
+  };
+  Cts.push_back(ConstantExpr::getGetElementPtr(GV, GEPs, 3));
   
   std::vector<Constant*> Vals;
   for (uint32 i = 0; i < bytes->size; ++i) {
@@ -1640,6 +1689,8 @@ Constant* JavaAOTCompiler::CreateConstantFromVT(JavaVirtualTable* VT) {
     if (classDef->isSubclassOf(
           classDef->classLoader->bootstrapLoader->upcalls->newReference)) {
       Tracer = ReferenceObjectTracer;
+    } else if (classDef->asClass()->nbReferenceOffsets == 0) {
+      Tracer = NoReferenceObjectTracer;
     } else {
       Tracer = RegularObjectTracer;
     }
@@ -1665,7 +1716,7 @@ Constant* JavaAOTCompiler::CreateConstantFromVT(JavaVirtualTable* VT) {
   Elemts.push_back(ConstantExpr::getIntToPtr(
         ConstantInt::get(Type::getInt64Ty(getLLVMContext()), VT->offset), PTy));
   
-  // cache
+  // secondaryTable, built at run time
   Elemts.push_back(N);
   
   // display
@@ -1891,6 +1942,11 @@ JavaAOTCompiler::JavaAOTCompiler(
                                            "ReferenceObjectTracer",
                                            getLLVMModule());
   
+  NoReferenceObjectTracer = Function::Create(FTy,
+                                             GlobalValue::ExternalLinkage,
+                                             "NoReferenceObjectTracer",
+                                             getLLVMModule());
+  
   EmptyDestructorFunction = Function::Create(FTy,
                                              GlobalValue::ExternalLinkage,
                                              "EmptyDestructor",
@@ -2095,9 +2151,9 @@ void extractFiles(ClassBytes* bytes,
    
   vmkit::BumpPtrAllocator allocator; 
   char* realName = (char*)allocator.Allocate(4096, "temp");
-  for (ZipArchive::table_iterator i = archive.filetable.begin(), 
-       e = archive.filetable.end(); i != e; ++i) {
-    ZipFile* file = i->second;
+  for (ZipArchive::table_iterator i = archive.begin(), 
+       e = archive.end(); i != e; ++i) {
+    ZipFile* file = *i;
      
     char* name = file->filename;
     uint32 size = strlen(name);
@@ -2111,11 +2167,11 @@ void extractFiles(ClassBytes* bytes,
       classes.push_back(cl);  
     } else if (size > 4 && (!strcmp(&name[size - 4], ".jar") || 
                             !strcmp(&name[size - 4], ".zip"))) {
-      ClassBytes* res = new (allocator, file->ucsize) ClassBytes(file->ucsize);
-      int ok = archive.readFile(res, file);
-      if (!ok) return;
+      ClassBytes* res = archive.getContents(file);
+      if (res == NULL) return;
       
       extractFiles(res, M, bootstrapLoader, classes);
+      archive.releaseContents(file);
     }
   }
 }
@@ -2257,8 +2313,8 @@ void mainCompilerStart(JavaThread* th) {
       bootstrapLoader->setCompiler(M);
     }
 
-    // We don't want strings to be interned when AOT'ing, otherwise
-    // we would call Java code.
+    // We don't want strings to be interned when AOT'ing: the strings
+    // interned by this VM are not the ones of the VM running the code.
     bootstrapLoader->upcalls->internString = NULL;
    
     // Set the thread as the owner of the classes, so that it knows it
@@ -2458,12 +2514,13 @@ void JavaAOTCompiler::generateClassBytes(JnjvmBootstrapLoader* loader) {
   for (std::vector<ZipArchive*>::iterator i = loader->bootArchives.begin(),
        e = loader->bootArchives.end(); i != e; ++i) {
     ZipArchive* archive = *i;
-    for (ZipArchive::table_iterator zi = archive->filetable.begin(),
-         ze = archive->filetable.end(); zi != ze; zi++) {
+    for (ZipArchive::table_iterator zi = archive->begin(),
+         ze = archive->end(); zi != ze; ++zi) {
       // Remove the '.class'.
-      const char* name = zi->first;
+      ZipFile* file = *zi;
+      const char* name = file->filename;
       std::string str(name, strlen(name) - strlen(".class"));
-      ClassBytes* bytes = Reader::openZip(loader, archive, name);
+      ClassBytes* bytes = Reader::openZip(loader, archive, file);
       getClassBytes(loader->asciizConstructUTF8(str.c_str()), bytes);
     }
   }
@@ -20,6 +20,7 @@
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
 #include <llvm/Support/CFG.h>
@@ -39,6 +40,7 @@
 #include "JavaUpcalls.h"
 #include "Jnjvm.h"
 #include "Reader.h"
+#include "VMStaticInstance.h"
 
 #include "j3/JavaLLVMCompiler.h"
 #include "j3/J3Intrinsics.h"
@@ -94,6 +96,34 @@ void JavaJIT::checkYieldPoint() {
   currentBlock = continueBlock;
 }
 
+void JavaJIT::countHotness(Value* counter, uint32 threshold) {
+  Value* Meth = TheCompiler->getMethodInClass(compilingMethod);
+  Value* GEP[2] = { intrinsics->constantZero, counter };
+  Value* CounterPtr = GetElementPtrInst::Create(Meth, GEP, "", currentBlock);
+
+  // The counters are not updated atomically: losing a few increments only
+  // delays the promotion.
+  Value* Count = new LoadInst(CounterPtr, "", currentBlock);
+  Count = BinaryOperator::CreateAdd(Count, intrinsics->constantOne, "",
+                                    currentBlock);
+  new StoreInst(Count, CounterPtr, currentBlock);
+
+  Value* Threshold = ConstantInt::get(Type::getInt32Ty(*llvmContext),
+                                      threshold);
+  Value* Hot = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, Count,
+                            Threshold, "");
+
+  BasicBlock* continueBlock = createBasicBlock("afterPromotion");
+  BasicBlock* promoteBlock = createBasicBlock("promote");
+  BranchInst::Create(promoteBlock, continueBlock, Hot, currentBlock);
+
+  currentBlock = promoteBlock;
+  CallInst::Create(intrinsics->PromoteMethodFunction, Meth, "", currentBlock);
+  BranchInst::Create(continueBlock, currentBlock);
+
+  currentBlock = continueBlock;
+}
+
 bool JavaJIT::canBeInlined(JavaMethod* meth, bool customizing) {
   if (inlineMethods[meth]) return false;
   if (isSynchro(meth->access)) return false;
@@ -196,8 +226,26 @@ void JavaJIT::invokeVirtual(uint16 index) {
   FunctionType::param_iterator it  = virtualType->param_end();
   llvm::Type* retType = virtualType->getReturnType();
 
+  JnjvmBootstrapLoader* loader = compilingClass->classLoader->bootstrapLoader;
   bool needsInit = false;
-  if (canBeDirect && canBeInlined(meth, customized)) {
+  if (canBeDirect && !TheCompiler->isStaticCompiling() &&
+      meth->classDef->name->equals(loader->unsafeName)) {
+    makeArgs(it, index, args, signature->nbArguments + 1);
+    if (!thisReference) JITVerifyNull(args[0]);
+    val = lowerUnsafeOps(name, args, retType);
+    if (val == NULL) {
+      // Not an intrinsic: call the native method through the virtual table,
+      // which works whether or not the method has been linked yet.
+      Value* VT = CallInst::Create(intrinsics->GetVTFunction, args[0], "",
+                                   currentBlock);
+      Value* indexes[2] = { intrinsics->constantZero,
+                            TheCompiler->getMethodInfo(meth)->getOffset() };
+      Value* Func = GetElementPtrInst::Create(VT, indexes, "", currentBlock);
+      Func = new LoadInst(Func, "", currentBlock);
+      Func = new BitCastInst(Func, LSI->getVirtualPtrType(), "", currentBlock);
+      val = invoke(Func, args, "", currentBlock);
+    }
+  } else if (canBeDirect && canBeInlined(meth, customized)) {
     makeArgs(it, index, args, signature->nbArguments + 1);
     if (!thisReference) JITVerifyNull(args[0]);
     val = invokeInline(meth, args, customized);
@@ -258,6 +306,18 @@ void JavaJIT::invokeVirtual(uint16 index) {
     if (!nullChecked && !thisReference) JITVerifyNull(args[0]);
     Value* VT = CallInst::Create(intrinsics->GetVTFunction, args[0], "",
                                  currentBlock);
+
+    // Baseline code finds the receivers of the call site, and optimised code
+    // calls them directly.
+    InlineCache* cache = meth ? getInlineCache() : NULL;
+    if (cache != NULL) {
+      if (baseline) {
+        recordReceiver(cache, VT, args[0],
+                       TheCompiler->getMethodInClass(meth));
+      } else {
+        invokeCachedReceivers(cache, VT, args, retType, endBlock, node);
+      }
+    }
  
     Value* FuncPtr = GetElementPtrInst::Create(VT, indexes2, "", currentBlock);
     
@@ -289,6 +349,98 @@ void JavaJIT::invokeVirtual(uint16 index) {
   }
 }
 
+InlineCache* JavaJIT::getInlineCache() {
+  // The cache is referenced by its address.
+  if (TheCompiler->isStaticCompiling()) return NULL;
+  return compilingMethod->getInlineCache(currentBytecodeIndex);
+}
+
+Value* JavaJIT::loadInlineCacheEntry(void* address, Type* type) {
+  Value* ptr = ConstantInt::get(intrinsics->pointerSizeType, (word_t)address);
+  ptr = ConstantExpr::getIntToPtr(cast<Constant>(ptr),
+                                  PointerType::getUnqual(type));
+  return new LoadInst(ptr, "", currentBlock);
+}
+
+void JavaJIT::invokeCachedReceivers(InlineCache* cache, Value* VT,
+                                    std::vector<Value*>& args, Type* retType,
+                                    BasicBlock*& endBlock, PHINode*& node) {
+  // Megamorphic call sites go through the tables.
+  if (cache->megamorphic) return;
+
+  Value* vt = new PtrToIntInst(VT, intrinsics->pointerSizeType, "",
+                               currentBlock);
+  for (uint32 i = 0; i < InlineCache::NumEntries; ++i) {
+    // The entry is complete once its VT is set.
+    JavaVirtualTable* cachedVT = cache->VT[i];
+    if (cachedVT == NULL) continue;
+    JavaMethod* callee = cache->methods[i];
+    bool needsInit = false;
+    if (TheCompiler->needsCallback(callee, NULL, &needsInit)) continue;
+
+    if (endBlock == NULL) {
+      endBlock = createBasicBlock("endCachedInvoke");
+      if (retType != Type::getVoidTy(*llvmContext)) {
+        node = PHINode::Create(retType, InlineCache::NumEntries + 1, "",
+                               endBlock);
+      }
+    }
+
+    Value* test = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, vt,
+        ConstantInt::get(intrinsics->pointerSizeType, (word_t)cachedVT), "");
+    BasicBlock* callBlock = createBasicBlock("cachedInvoke");
+    BasicBlock* nextBlock = createBasicBlock("notCachedInvoke");
+    BranchInst::Create(callBlock, nextBlock, test, currentBlock);
+
+    currentBlock = callBlock;
+    Value* val = invoke(TheCompiler->getMethod(callee, NULL), args, "",
+                        currentBlock);
+    if (node != NULL) node->addIncoming(val, currentBlock);
+    BranchInst::Create(endBlock, currentBlock);
+
+    currentBlock = nextBlock;
+  }
+}
+
+void JavaJIT::updateInlineCache(InlineCache* cache, Value* obj, Value* Meth) {
+  Value* megamorphic = loadInlineCacheEntry(&(cache->megamorphic),
+                                            Type::getInt32Ty(*llvmContext));
+  Value* test = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, megamorphic,
+                             intrinsics->constantZero, "");
+  BasicBlock* missBlock = createBasicBlock("updateInlineCache");
+  BasicBlock* endBlock = createBasicBlock("endUpdateInlineCache");
+  BranchInst::Create(missBlock, endBlock, test, currentBlock);
+
+  currentBlock = missBlock;
+  Value* Cache = ConstantInt::get(intrinsics->pointerSizeType, (word_t)cache);
+  Cache = ConstantExpr::getIntToPtr(cast<Constant>(Cache), intrinsics->ptrType);
+  Value* Args[3] = { obj, Meth, Cache };
+  CallInst::Create(intrinsics->InlineCacheMissFunction, Args, "",
+                   currentBlock);
+  BranchInst::Create(endBlock, currentBlock);
+
+  currentBlock = endBlock;
+}
+
+void JavaJIT::recordReceiver(InlineCache* cache, Value* VT, Value* obj,
+                             Value* Meth) {
+  BasicBlock* endBlock = createBasicBlock("receiverRecorded");
+  Value* vt = new PtrToIntInst(VT, intrinsics->pointerSizeType, "",
+                               currentBlock);
+  for (uint32 i = 0; i < InlineCache::NumEntries; ++i) {
+    Value* cachedVT = loadInlineCacheEntry(&(cache->VT[i]),
+                                           intrinsics->pointerSizeType);
+    Value* test = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, vt, cachedVT,
+                               "");
+    BasicBlock* nextBlock = createBasicBlock("receiverNotRecorded");
+    BranchInst::Create(endBlock, nextBlock, test, currentBlock);
+    currentBlock = nextBlock;
+  }
+  updateInlineCache(cache, obj, Meth);
+  BranchInst::Create(endBlock, currentBlock);
+  currentBlock = endBlock;
+}
+
 llvm::Value* JavaJIT::getMutatorThreadPtr() {
   Value* FrameAddr = CallInst::Create(intrinsics->llvm_frameaddress,
                                      	intrinsics->constantZero, "", currentBlock);
@@ -657,33 +809,115 @@ llvm::Value* JavaJIT::objectToHeader(Value* obj) {
 	return new IntToPtrInst(obj, intrinsics->ObjectHeaderType, "objectHeader", currentBlock);
 }
 
+Value* JavaJIT::isBiasedTowards(Value* header, Value* threadId) {
+  Value* BiasMask = ConstantInt::get(intrinsics->pointerSizeType,
+      vmkit::System::GetThreadIDMask() | vmkit::ThinLock::FatMask |
+      vmkit::ThinLock::BiasedMask);
+  Value* BiasedMask = ConstantInt::get(intrinsics->pointerSizeType,
+                                       vmkit::ThinLock::BiasedMask);
+
+  Value* bias = BinaryOperator::CreateAnd(header, BiasMask, "", currentBlock);
+  Value* biased = BinaryOperator::CreateOr(threadId, BiasedMask, "",
+                                           currentBlock);
+  return new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, bias, biased, "");
+}
+
+void JavaJIT::setBiasedCount(Value* lockPtr, Value* header) {
+  // Only write the byte of the count, other threads may change the other
+  // non-lock bits.
+  Value* ThinCountShift = ConstantInt::get(intrinsics->pointerSizeType,
+                                           vmkit::ThinLock::ThinCountShift);
+  Value* count = BinaryOperator::CreateLShr(header, ThinCountShift, "",
+                                            currentBlock);
+  count = new TruncInst(count, Type::getInt8Ty(*llvmContext), "",
+                        currentBlock);
+  Value* countPtr = new BitCastInst(lockPtr, intrinsics->ptrType, "",
+                                    currentBlock);
+  Value* index = ConstantInt::get(Type::getInt32Ty(*llvmContext),
+                                  vmkit::ThinLock::BiasedCountByte);
+  countPtr = GetElementPtrInst::Create(countPtr, index, "", currentBlock);
+  new StoreInst(count, countPtr, true, currentBlock);
+}
+
 void JavaJIT::monitorEnter(Value* obj) {
   Value* lockPtr = objectToHeader(obj);
 
-  Value* lock = new LoadInst(lockPtr, "", currentBlock);
+  Value* header = new LoadInst(lockPtr, "", currentBlock);
+
+  Value* threadId = getMutatorThreadPtr();
+  threadId = new PtrToIntInst(threadId, intrinsics->pointerSizeType, "",
+                              currentBlock);
+
+  Value* ThinCountMask = ConstantInt::get(intrinsics->pointerSizeType,
+                                          vmkit::ThinLock::ThinCountMask);
+  Value* ThinCountAdd = ConstantInt::get(intrinsics->pointerSizeType,
+                                         vmkit::ThinLock::ThinCountAdd);
+
+  BasicBlock* OK = createBasicBlock("synchronize passed");
+  BasicBlock* Biased = createBasicBlock("synchronize biased");
+  BasicBlock* NotBiased = createBasicBlock("synchronize not biased");
+  BasicBlock* NotOK = createBasicBlock("synchronize did not pass");
 
+  // If the lock is biased towards this thread, increment the count with a
+  // plain store.
+  Value* cmp = isBiasedTowards(header, threadId);
+  Value* count = BinaryOperator::CreateAnd(header, ThinCountMask, "",
+                                           currentBlock);
+  Value* notFull = new ICmpInst(*currentBlock, ICmpInst::ICMP_NE, count,
+                                ThinCountMask, "");
+  cmp = BinaryOperator::CreateAnd(cmp, notFull, "", currentBlock);
+  BranchInst::Create(Biased, NotBiased, cmp, currentBlock);
+
+  currentBlock = Biased;
+  Value* newHeader = BinaryOperator::CreateAdd(header, ThinCountAdd, "",
+                                               currentBlock);
+  setBiasedCount(lockPtr, newHeader);
+  BranchInst::Create(OK, currentBlock);
+
+  currentBlock = NotBiased;
   Value* NonLockBitsMask = ConstantInt::get(intrinsics->pointerSizeType,
                                             vmkit::ThinLock::NonLockBitsMask);
 
-  lock = BinaryOperator::CreateAnd(lock, NonLockBitsMask, "", currentBlock);
+  Value* lock = BinaryOperator::CreateAnd(header, NonLockBitsMask, "",
+                                          currentBlock);
 
-  Value* threadId = getMutatorThreadPtr();
-  threadId = new PtrToIntInst(threadId, intrinsics->pointerSizeType, "",
-                              currentBlock);
   Value* newValMask = BinaryOperator::CreateOr(threadId, lock, "",
                                                currentBlock);
 
+  // Take the bias if the lock has never been revoked, and the class of the
+  // object has not had too many revocations.
+  Value* UnbiasableMask = ConstantInt::get(intrinsics->pointerSizeType,
+                                           vmkit::ThinLock::UnbiasableMask);
+  Value* unbiasable = BinaryOperator::CreateAnd(lock, UnbiasableMask, "",
+                                                currentBlock);
+  unbiasable = new ICmpInst(*currentBlock, ICmpInst::ICMP_NE, unbiasable,
+                            intrinsics->constantPtrZero, "");
+  Value* cl = CallInst::Create(intrinsics->GetClassFunction, obj, "",
+                               currentBlock);
+  Value* indexes[2] = { intrinsics->constantZero,
+                        intrinsics->OffsetAccessInCommonClassConstant };
+  Value* access = GetElementPtrInst::Create(cl, indexes, "", currentBlock);
+  access = new LoadInst(access, "", false, currentBlock);
+  Value* UnbiasableClass = ConstantInt::get(Type::getInt32Ty(*llvmContext),
+                                            JNJVM_UNBIASABLE);
+  access = BinaryOperator::CreateAnd(access, UnbiasableClass, "",
+                                     currentBlock);
+  access = new ICmpInst(*currentBlock, ICmpInst::ICMP_NE, access,
+                        intrinsics->constantZero, "");
+  unbiasable = BinaryOperator::CreateOr(unbiasable, access, "", currentBlock);
+  Value* bias = ConstantInt::get(intrinsics->pointerSizeType,
+      vmkit::ThinLock::BiasedMask | vmkit::ThinLock::ThinCountAdd);
+  bias = SelectInst::Create(unbiasable, intrinsics->constantPtrZero, bias, "",
+                            currentBlock);
+  newValMask = BinaryOperator::CreateOr(newValMask, bias, "", currentBlock);
+
   // Do the atomic compare and swap.
   Value* atomic = new AtomicCmpXchgInst(
       lockPtr, lock, newValMask, SequentiallyConsistent, CrossThread,
       currentBlock);
   
-  Value* cmp = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, atomic,
-                            lock, "");
+  cmp = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, atomic, lock, "");
   
-  BasicBlock* OK = createBasicBlock("synchronize passed");
-  BasicBlock* NotOK = createBasicBlock("synchronize did not pass");
-
   BranchInst::Create(OK, NotOK, cmp, currentBlock);
 
   // The atomic CAS did not work.
@@ -694,7 +928,7 @@ void JavaJIT::monitorEnter(Value* obj) {
   currentBlock = OK;
 }
 
-void JavaJIT::monitorExit(Value* obj) {
+void JavaJIT::monitorExit(Value* obj, bool mayThrow) {
 	// obj should not be null if we are here.
     BasicBlock* nonNullObjBlock = createBasicBlock("monitorExit_nonNullObj");
     BasicBlock* EndBlock = createBasicBlock("monitorExit_End");
@@ -708,31 +942,54 @@ void JavaJIT::monitorExit(Value* obj) {
 
   Value* lock = new LoadInst(lockPtr, "", currentBlock);
 
+  Value* threadId = getMutatorThreadPtr();
+  threadId = new PtrToIntInst(threadId, intrinsics->pointerSizeType, "",
+                              currentBlock);
+
+  Value* ThinCountMask = ConstantInt::get(intrinsics->pointerSizeType,
+                                          vmkit::ThinLock::ThinCountMask);
+  Value* ThinCountAdd = ConstantInt::get(intrinsics->pointerSizeType,
+                                         vmkit::ThinLock::ThinCountAdd);
+
+  BasicBlock* Biased = createBasicBlock("monitorExit_Biased");
+  BasicBlock* NotBiased = createBasicBlock("monitorExit_NotBiased");
+
+  // If the lock is biased towards this thread, decrement the count with a
+  // plain store.
+  Value* cmp = isBiasedTowards(lock, threadId);
+  Value* count = BinaryOperator::CreateAnd(lock, ThinCountMask, "",
+                                           currentBlock);
+  Value* held = new ICmpInst(*currentBlock, ICmpInst::ICMP_NE, count,
+                             intrinsics->constantPtrZero, "");
+  cmp = BinaryOperator::CreateAnd(cmp, held, "", currentBlock);
+  BranchInst::Create(Biased, NotBiased, cmp, currentBlock);
+
+  currentBlock = Biased;
+  Value* newHeader = BinaryOperator::CreateSub(lock, ThinCountAdd, "",
+                                               currentBlock);
+  setBiasedCount(lockPtr, newHeader);
+  BranchInst::Create(EndBlock, currentBlock);
+
+  currentBlock = NotBiased;
+  // A lock biased towards this thread with a count of zero is not held: its
+  // header never matches, so that the runtime throws the exception.
   Value* NonLockBitsMask = ConstantInt::get(
-      intrinsics->pointerSizeType, vmkit::ThinLock::NonLockBitsMask);
+      intrinsics->pointerSizeType,
+      vmkit::ThinLock::NonLockBitsMask & ~vmkit::ThinLock::BiasedMask);
 
   Value* lockedMask = BinaryOperator::CreateAnd(
       lock, NonLockBitsMask, "", currentBlock);
   
-  Value* threadId = getMutatorThreadPtr();
-  threadId = new PtrToIntInst(threadId, intrinsics->pointerSizeType, "",
-                              currentBlock);
-  
   Value* oldValMask = BinaryOperator::CreateOr(threadId, lockedMask, "",
                                                currentBlock);
 
-  std::vector<Value*> atomicArgs;
-  atomicArgs.push_back(lockPtr);
-  atomicArgs.push_back(oldValMask);
-  atomicArgs.push_back(lockedMask);
-
   // Do the atomic compare and swap.
   Value* atomic = new AtomicCmpXchgInst(
       lockPtr, oldValMask, lockedMask, SequentiallyConsistent, CrossThread,
       currentBlock);
   
-  Value* cmp = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, atomic,
-                            oldValMask, "");
+  cmp = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, atomic,
+                     oldValMask, "");
   
   BasicBlock* LockFreeCASFailed = createBasicBlock("Lock-Free CAS Failed");
 
@@ -740,7 +997,11 @@ void JavaJIT::monitorExit(Value* obj) {
 
   // The atomic cas did not work.
   currentBlock = LockFreeCASFailed;
-  CallInst::Create(intrinsics->ReleaseObjectFunction, obj, "", currentBlock);
+  if (mayThrow) {
+    invoke(intrinsics->ReleaseObjectFunction, obj, "");
+  } else {
+    CallInst::Create(intrinsics->ReleaseObjectFunction, obj, "", currentBlock);
+  }
   BranchInst::Create(EndBlock, currentBlock);
 
   currentBlock = EndBlock;
@@ -1137,6 +1398,18 @@ llvm::Function* JavaJIT::javaCompile() {
 
   reader.cursor = start;
   exploreOpcodes(reader, codeLen);
+
+  // There is no on-stack replacement: a baseline frame stuck in a long loop
+  // would never reach the optimised code. Methods with loops are compiled
+  // with all optimisations right away.
+  if (baseline) {
+    for (uint32 i = 0; i < codeLen; ++i) {
+      if (opcodeInfos[i].backEdge) {
+        baseline = false;
+        break;
+      }
+    }
+  }
  
   endBlock = createBasicBlock("end");
 
@@ -1145,6 +1418,11 @@ llvm::Function* JavaJIT::javaCompile() {
   }
 
   checkYieldPoint();
+
+  if (baseline) {
+    countHotness(intrinsics->OffsetInvocationCountInJavaMethodConstant,
+                 JavaLLVMCompiler::InvocationThreshold);
+  }
   
   if (isSynchro(compilingMethod->access)) {
     beginSynchronize();
@@ -1371,9 +1649,18 @@ void JavaJIT::loadConstant(uint16 index) {
   }
 }
 
+bool JavaJIT::canUseHardwareNullCheck() {
+  if (!vmkit::System::SupportsHardwareNullCheck()) return false;
+  if (nbHandlers == 0) return true;
+  // Bytecodes outside of the try ranges of the method go to the end
+  // exception block, which only propagates the exception to the caller.
+  return !isSynchro(compilingMethod->access) &&
+         currentExceptionBlock == endExceptionBlock;
+}
+
 void JavaJIT::JITVerifyNull(Value* obj) {
   if (TheCompiler->hasExceptionsEnabled()) {
-    if (nbHandlers == 0 && vmkit::System::SupportsHardwareNullCheck()) {
+    if (canUseHardwareNullCheck()) {
       Value* indexes[2] = { intrinsics->constantZero, intrinsics->JavaObjectVTOffsetConstant };
       Value* VTPtr = GetElementPtrInst::Create(obj, indexes, "", currentBlock);
       Instruction* VT = new LoadInst(VTPtr, "", true, currentBlock);
@@ -1577,6 +1864,145 @@ Instruction* JavaJIT::lowerMathOps(const UTF8* name,
 }
 
 
+Value* JavaJIT::unsafeFieldPtr(Value* base, Value* offset, Type* type) {
+  JITVerifyNull(base);
+
+  BasicBlock* StaticBase = createBasicBlock("unsafe_StaticBase");
+  BasicBlock* EndBase = createBasicBlock("unsafe_EndBase");
+  PHINode* node = PHINode::Create(intrinsics->ptrType, 2, "", EndBase);
+
+  // Static fields are accessed through a placeholder object, see
+  // VMStaticInstance.
+  Value* VT = CallInst::Create(intrinsics->GetVTFunction, base, "",
+                               currentBlock);
+  Value* StaticVT = ConstantExpr::getIntToPtr(
+      ConstantInt::get(intrinsics->pointerSizeType,
+                       (word_t)&VMStaticInstance::VT),
+      VT->getType());
+  Value* test = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, VT, StaticVT,
+                             "");
+  node->addIncoming(new BitCastInst(base, intrinsics->ptrType, "",
+                                    currentBlock),
+                    currentBlock);
+  BranchInst::Create(StaticBase, EndBase, test, currentBlock);
+
+  currentBlock = StaticBase;
+  Value* res = CallInst::Create(intrinsics->StaticFieldBaseFunction, base, "",
+                                currentBlock);
+  node->addIncoming(res, currentBlock);
+  BranchInst::Create(EndBase, currentBlock);
+
+  currentBlock = EndBase;
+  Value* ptr = GetElementPtrInst::Create(node, offset, "", currentBlock);
+  return new BitCastInst(ptr, PointerType::getUnqual(type), "", currentBlock);
+}
+
+Value* JavaJIT::lowerUnsafeOps(const UTF8* name, std::vector<Value*>& args,
+                               Type* retType) {
+  JnjvmBootstrapLoader* loader = compilingClass->classLoader->bootstrapLoader;
+
+  if (name->equals(loader->compareAndSwapInt) ||
+      name->equals(loader->compareAndSwapLong) ||
+      name->equals(loader->compareAndSwapObject)) {
+    Value* expect = args[3];
+    Value* update = args[4];
+    Type* type = expect->getType();
+    if (type == intrinsics->JavaObjectType) {
+      // Let the collector do the compare and swap if it needs a barrier.
+      if (vmkit::Collector::needsWriteBarrier()) return NULL;
+      // cmpxchg only operates on integers.
+      type = intrinsics->pointerSizeType;
+      expect = new PtrToIntInst(expect, type, "", currentBlock);
+      update = new PtrToIntInst(update, type, "", currentBlock);
+    }
+    Value* ptr = unsafeFieldPtr(args[1], args[2], type);
+    Value* old = new AtomicCmpXchgInst(ptr, expect, update,
+                                       SequentiallyConsistent, CrossThread,
+                                       currentBlock);
+    Value* res = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, old, expect,
+                              "");
+    return new ZExtInst(res, retType, "", currentBlock);
+  }
+
+  bool isGet = false;
+  bool isVolatile = false;
+  bool isOrdered = false;
+  if (name->equals(loader->getInt) ||
+      name->equals(loader->getLong) ||
+      name->equals(loader->getObject)) {
+    isGet = true;
+  } else if (name->equals(loader->getIntVolatile) ||
+             name->equals(loader->getLongVolatile) ||
+             name->equals(loader->getObjectVolatile)) {
+    isGet = true;
+    isVolatile = true;
+  } else if (name->equals(loader->putIntVolatile) ||
+             name->equals(loader->putLongVolatile) ||
+             name->equals(loader->putObjectVolatile)) {
+    isVolatile = true;
+  } else if (name->equals(loader->putOrderedInt) ||
+             name->equals(loader->putOrderedLong) ||
+             name->equals(loader->putOrderedObject)) {
+    isOrdered = true;
+  } else if (!name->equals(loader->putInt) &&
+             !name->equals(loader->putLong) &&
+             !name->equals(loader->putObject)) {
+    return NULL;
+  }
+
+  if (isGet) {
+    Value* ptr = NULL;
+    if (args.size() == 2) {
+      // The accessor takes an address instead of a base object and offset.
+      ptr = new IntToPtrInst(args[1], PointerType::getUnqual(retType), "",
+                             currentBlock);
+    } else {
+      ptr = unsafeFieldPtr(args[1], args[2], retType);
+    }
+    Value* res = new LoadInst(ptr, "", isVolatile, currentBlock);
+    if (isVolatile) {
+      new FenceInst(*llvmContext, Acquire, CrossThread, currentBlock);
+    }
+    return res;
+  }
+
+  Value* val = args.back();
+  Type* type = val->getType();
+  // The accessor takes an address instead of a base object and offset.
+  bool isAddress = (args.size() == 3);
+  Value* ptr = NULL;
+  if (isAddress) {
+    ptr = new IntToPtrInst(args[1], PointerType::getUnqual(type), "",
+                           currentBlock);
+  } else {
+    ptr = unsafeFieldPtr(args[1], args[2], type);
+  }
+  // Earlier stores must not be reordered after a volatile or ordered store,
+  // as they are not after the call to the native implementation.
+  if (isVolatile || isOrdered) {
+    new FenceInst(*llvmContext, isVolatile ? SequentiallyConsistent : Release,
+                  CrossThread, currentBlock);
+  }
+  Instruction* res = NULL;
+  if (!isAddress && vmkit::Collector::needsWriteBarrier() &&
+      type == intrinsics->JavaObjectType) {
+    Value* object = new BitCastInst(args[1], intrinsics->ptrType, "",
+                                    currentBlock);
+    ptr = new BitCastInst(ptr, intrinsics->ptrPtrType, "", currentBlock);
+    val = new BitCastInst(val, intrinsics->ptrType, "", currentBlock);
+    Value* barrierArgs[3] = { object, ptr, val };
+    res = CallInst::Create(intrinsics->FieldWriteBarrierFunction, barrierArgs,
+                           "", currentBlock);
+  } else {
+    res = new StoreInst(val, ptr, isVolatile || isOrdered, currentBlock);
+  }
+  if (isVolatile) {
+    new FenceInst(*llvmContext, SequentiallyConsistent, CrossThread,
+                  currentBlock);
+  }
+  return res;
+}
+
 Instruction* JavaJIT::lowerFloatOps(const UTF8* name, 
                                     std::vector<Value*>& args) {
   JnjvmBootstrapLoader* loader = compilingClass->classLoader->bootstrapLoader;
@@ -1737,6 +2163,10 @@ void JavaJIT::invokeStatic(uint16 index) {
     val = lowerFloatOps(name, args);
   } else if (className->equals(loader->VMDoubleName)) {
     val = lowerDoubleOps(name, args);
+  } else if (className->equals(loader->systemName) &&
+             name->equals(loader->arraycopy)) {
+    lowerArraycopy(args, func);
+    return;
   }
     
   if (val == NULL) {
@@ -2215,6 +2645,14 @@ void JavaJIT::invokeInterface(uint16 index) {
   targetObject = new LoadInst(
           targetObject, "", false, currentBlock);
   if (!thisReference) JITVerifyNull(targetObject);
+
+  std::vector<Value*> args; // size = [signature->nbIn + 3];
+  FunctionType::param_iterator it  = virtualType->param_end();
+  makeArgs(it, index, args, signature->nbArguments + 1);
+
+  BasicBlock* endBlock = 0;
+  PHINode* retNode = 0;
+  InlineCache* cache = getInlineCache();
   // TODO: The following code needs more testing.
 #if 0
   BasicBlock* endBlock = createBasicBlock("end interface invoke");
@@ -2312,19 +2750,67 @@ void JavaJIT::invokeInterface(uint16 index) {
       
   currentBlock = endBlock;
 #else
+  BasicBlock* resolveBlock = NULL;
+  BasicBlock* resolvedBlock = NULL;
+  PHINode* node = NULL;
+  if (cache != NULL) {
+    Value* VT = CallInst::Create(intrinsics->GetVTFunction, targetObject, "",
+                                 currentBlock);
+    if (!baseline) {
+      invokeCachedReceivers(cache, VT, args, retType, endBlock, retNode);
+    }
+
+    // Look the receiver up in the cache before looking up the interface
+    // method table.
+    resolveBlock = createBasicBlock("resolveInterface");
+    resolvedBlock = createBasicBlock("endResolveInterface");
+    node = PHINode::Create(intrinsics->ptrType, InlineCache::NumEntries + 1,
+                           "", resolvedBlock);
+    VT = new PtrToIntInst(VT, intrinsics->pointerSizeType, "", currentBlock);
+    for (uint32 i = 0; i < InlineCache::NumEntries; ++i) {
+      Value* cachedVT = loadInlineCacheEntry(&(cache->VT[i]),
+                                             intrinsics->pointerSizeType);
+      Value* test = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, VT,
+                                 cachedVT, "");
+      BasicBlock* hitBlock = createBasicBlock("inlineCacheHit");
+      BasicBlock* nextBlock = createBasicBlock("inlineCacheMiss");
+      BranchInst::Create(hitBlock, nextBlock, test, currentBlock);
+      currentBlock = hitBlock;
+      node->addIncoming(loadInlineCacheEntry(&(cache->code[i]),
+                                             intrinsics->ptrType),
+                        currentBlock);
+      BranchInst::Create(resolvedBlock, currentBlock);
+      currentBlock = nextBlock;
+    }
+    updateInlineCache(cache, targetObject, Meth);
+    BranchInst::Create(resolveBlock, currentBlock);
+    currentBlock = resolveBlock;
+  }
+
   std::vector<Value*> Args;
   Args.push_back(targetObject);
   Args.push_back(Meth);
   Args.push_back(Index);
-  Value* node = invoke(intrinsics->ResolveInterfaceFunction,
+  Value* func = invoke(intrinsics->ResolveInterfaceFunction,
                        Args, "invokeinterface", currentBlock);
-  node = new BitCastInst(node, virtualPtrType, "", currentBlock);
+  if (node != NULL) {
+    node->addIncoming(func, currentBlock);
+    BranchInst::Create(resolvedBlock, currentBlock);
+    currentBlock = resolvedBlock;
+    func = node;
+  }
+  func = new BitCastInst(func, virtualPtrType, "", currentBlock);
 #endif
 
-  std::vector<Value*> args; // size = [signature->nbIn + 3];
-  FunctionType::param_iterator it  = virtualType->param_end();
-  makeArgs(it, index, args, signature->nbArguments + 1);
-  Value* ret = invoke(node, args, "", currentBlock);
+  Value* ret = invoke(func, args, "", currentBlock);
+  if (endBlock) {
+    if (retNode) {
+      retNode->addIncoming(ret, currentBlock);
+      ret = retNode;
+    }
+    BranchInst::Create(endBlock, currentBlock);
+    currentBlock = endBlock;
+  }
   if (retType != Type::getVoidTy(*llvmContext)) {
     if (ret->getType() == intrinsics->JavaObjectType) {
       JnjvmClassLoader* JCL = compilingClass->classLoader;
@@ -2639,9 +3125,128 @@ void JavaJIT::finishExceptions() {
   }
 }
 
+void JavaJIT::lowerArraycopy(std::vector<Value*>& args, Value* func) {
+  Value* src = args[0];
+  Value* srcStart = args[1];
+  Value* dst = args[2];
+  Value* dstStart = args[3];
+  Value* length = args[4];
+
+  JITVerifyNull(src);
+  JITVerifyNull(dst);
+
+  BasicBlock* IsArray = createBasicBlock("arraycopy_IsArray");
+  BasicBlock* InBounds = createBasicBlock("arraycopy_InBounds");
+  BasicBlock* PrimitiveSize = createBasicBlock("arraycopy_PrimitiveSize");
+  BasicBlock* Copy = createBasicBlock("arraycopy_Copy");
+  BasicBlock* Runtime = createBasicBlock("arraycopy_Runtime");
+  BasicBlock* End = createBasicBlock("arraycopy_End");
+
+  // Only copies between arrays of the same type are inlined: they need no
+  // type check of the elements.
+  Value* srcVT = CallInst::Create(intrinsics->GetVTFunction, src, "",
+                                  currentBlock);
+  Value* dstVT = CallInst::Create(intrinsics->GetVTFunction, dst, "",
+                                  currentBlock);
+  Value* test = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, srcVT, dstVT,
+                             "");
+  BranchInst::Create(IsArray, Runtime, test, currentBlock);
 
-#ifdef USE_OPENJDK
-#include "JavaJITOpenJDK.inc"
-#else
-#include "JavaJITClasspath.inc"
-#endif
+  currentBlock = IsArray;
+  Value* zero = ConstantInt::get(Type::getInt16Ty(*llvmContext), 0);
+  Value* cl = CallInst::Create(intrinsics->GetClassFunction, src, "",
+                               currentBlock);
+  Value* indexes[3] = { intrinsics->constantZero,
+                        intrinsics->OffsetAccessInCommonClassConstant, NULL };
+  Value* access = GetElementPtrInst::Create(cl, ArrayRef<Value*>(indexes, 2),
+                                            "", currentBlock);
+  access = new LoadInst(access, "", false, currentBlock);
+  test = BinaryOperator::CreateAnd(access, intrinsics->IsArrayConstant, "",
+                                   currentBlock);
+  test = new ICmpInst(*currentBlock, ICmpInst::ICMP_NE, test, zero, "");
+  BranchInst::Create(InBounds, Runtime, test, currentBlock);
+
+  // Negative indexes or lengths and copies out of the bounds of the arrays
+  // are left to the runtime, which throws the exception.
+  currentBlock = InBounds;
+  Value* negative = BinaryOperator::CreateOr(srcStart, dstStart, "",
+                                             currentBlock);
+  negative = BinaryOperator::CreateOr(negative, length, "", currentBlock);
+  test = new ICmpInst(*currentBlock, ICmpInst::ICMP_SGE, negative,
+                      intrinsics->constantZero, "");
+  Value* end = BinaryOperator::CreateAdd(srcStart, length, "", currentBlock);
+  Value* cmp = new ICmpInst(*currentBlock, ICmpInst::ICMP_ULE, end,
+                            arraySize(src), "");
+  test = BinaryOperator::CreateAnd(test, cmp, "", currentBlock);
+  end = BinaryOperator::CreateAdd(dstStart, length, "", currentBlock);
+  cmp = new ICmpInst(*currentBlock, ICmpInst::ICMP_ULE, end, arraySize(dst),
+                     "");
+  test = BinaryOperator::CreateAnd(test, cmp, "", currentBlock);
+  BranchInst::Create(PrimitiveSize, Runtime, test, currentBlock);
+
+  // Get the size of the elements. References are copied inline only if the
+  // collector does not need a write barrier.
+  currentBlock = PrimitiveSize;
+  PHINode* logSize = PHINode::Create(Type::getInt32Ty(*llvmContext), 2, "",
+                                     Copy);
+  Value* baseIndexes[2] = { intrinsics->constantZero,
+                            intrinsics->OffsetBaseClassInArrayClassConstant };
+  Value* baseClass = new BitCastInst(cl, intrinsics->JavaClassArrayType, "",
+                                     currentBlock);
+  baseClass = GetElementPtrInst::Create(baseClass, baseIndexes, "",
+                                        currentBlock);
+  baseClass = new LoadInst(baseClass, "", false, currentBlock);
+  access = GetElementPtrInst::Create(baseClass, ArrayRef<Value*>(indexes, 2),
+                                     "", currentBlock);
+  access = new LoadInst(access, "", false, currentBlock);
+  test = BinaryOperator::CreateAnd(access, intrinsics->IsPrimitiveConstant, "",
+                                   currentBlock);
+  test = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, test, zero, "");
+  BasicBlock* Primitive = createBasicBlock("arraycopy_Primitive");
+  if (vmkit::Collector::needsWriteBarrier()) {
+    BranchInst::Create(Runtime, Primitive, test, currentBlock);
+  } else {
+    logSize->addIncoming(ConstantInt::get(Type::getInt32Ty(*llvmContext),
+                                          vmkit::kWordSizeLog2),
+                         currentBlock);
+    BranchInst::Create(Copy, Primitive, test, currentBlock);
+  }
+  currentBlock = Primitive;
+  Value* logIndexes[2] = { intrinsics->constantZero,
+                           intrinsics->OffsetLogSizeInPrimitiveClassConstant };
+  Value* log = new BitCastInst(baseClass, intrinsics->JavaClassPrimitiveType,
+                               "", currentBlock);
+  log = GetElementPtrInst::Create(log, logIndexes, "", currentBlock);
+  log = new LoadInst(log, "", false, currentBlock);
+  logSize->addIncoming(log, currentBlock);
+  BranchInst::Create(Copy, currentBlock);
+
+  // Move the elements. LLVM expands small and constant sizes inline.
+  currentBlock = Copy;
+  srcStart = BinaryOperator::CreateShl(srcStart, logSize, "", currentBlock);
+  dstStart = BinaryOperator::CreateShl(dstStart, logSize, "", currentBlock);
+  length = BinaryOperator::CreateShl(length, logSize, "", currentBlock);
+
+  src = new BitCastInst(src, intrinsics->JavaArrayUInt8Type, "", currentBlock);
+  dst = new BitCastInst(dst, intrinsics->JavaArrayUInt8Type, "", currentBlock);
+  indexes[1] = intrinsics->JavaArrayElementsOffsetConstant;
+  indexes[2] = srcStart;
+  Value* srcPtr = GetElementPtrInst::Create(src, indexes, "", currentBlock);
+  indexes[2] = dstStart;
+  Value* dstPtr = GetElementPtrInst::Create(dst, indexes, "", currentBlock);
+
+  Type* Tys[3] = { intrinsics->ptrType, intrinsics->ptrType,
+                   Type::getInt32Ty(*llvmContext) };
+  Function* memmove = Intrinsic::getDeclaration(llvmFunction->getParent(),
+                                                Intrinsic::memmove, Tys);
+  Value* memmoveArgs[5] = { dstPtr, srcPtr, length, intrinsics->constantOne,
+                            ConstantInt::getFalse(*llvmContext) };
+  CallInst::Create(memmove, memmoveArgs, "", currentBlock);
+  BranchInst::Create(End, currentBlock);
+
+  currentBlock = Runtime;
+  invoke(func, args, "", currentBlock);
+  BranchInst::Create(End, currentBlock);
+
+  currentBlock = End;
+}
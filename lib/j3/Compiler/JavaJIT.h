@@ -34,6 +34,7 @@
 namespace j3 {
 
 class Class;
+class InlineCache;
 class JavaMethod;
 class Reader;
 
@@ -107,6 +108,7 @@ public:
     overridesThis = false;
     nbHandlers = 0;
     jmpBuffer = NULL;
+    baseline = false;
   }
 
   /// javaCompile - Compile the Java method.
@@ -118,6 +120,11 @@ public:
   /// isCustomizable - Whether we found the method to be customizable.
   bool isCustomizable;
 
+  /// baseline - Whether the method is compiled in the baseline tier. Baseline
+  /// code counts invocations to find hot methods. Methods with loops are not
+  /// compiled in the baseline tier.
+  bool baseline;
+
   // The number of handlers in that method.
   uint32_t nbHandlers;
 
@@ -266,6 +273,12 @@ private:
   
   /// JITVerifyNull - Insert a null pointer check in the LLVM code.
   void JITVerifyNull(llvm::Value* obj);
+
+  /// canUseHardwareNullCheck - Can a null pointer exception at the current
+  /// bytecode be thrown by the SIGSEGV handler? The handler unwinds the whole
+  /// method, so the exception must neither be caught in the method nor
+  /// release the lock of a synchronized method.
+  bool canUseHardwareNullCheck();
   
   
   /// verifyAndComputePtr - Computes the address in the array. If out of bounds
@@ -470,7 +483,17 @@ private:
   void monitorEnter(llvm::Value* obj);
   
   /// monitorExit - Emit synchronization code to release the lock of the value.
-  void monitorExit(llvm::Value* obj);
+  /// If mayThrow, the IllegalMonitorStateException thrown when the lock is
+  /// not held goes to the handlers of the method.
+  void monitorExit(llvm::Value* obj, bool mayThrow = false);
+
+  /// isBiasedTowards - Emit code to check whether the lock of the header is
+  /// biased towards the thread.
+  llvm::Value* isBiasedTowards(llvm::Value* header, llvm::Value* threadId);
+
+  /// setBiasedCount - Emit code to store the count of the new header of a
+  /// biased lock.
+  void setBiasedCount(llvm::Value* lockPtr, llvm::Value* header);
 
 //===----------------------- Java field accesses  -------------------------===//
 
@@ -530,6 +553,33 @@ private:
   /// invokeInterface - Invoke a Java interface method.
   void invokeInterface(uint16 index);
 
+  /// getInlineCache - Get the inline cache of the current call site. Returns
+  /// null if call sites are not cached.
+  InlineCache* getInlineCache();
+
+  /// loadInlineCacheEntry - Emit code to load a word of an inline cache.
+  llvm::Value* loadInlineCacheEntry(void* address, llvm::Type* type);
+
+  /// invokeCachedReceivers - Emit direct calls to the methods of the
+  /// receivers the inline cache has seen so far, guarded by the virtual table
+  /// of the receiver. Other receivers continue in the current block. The
+  /// calls branch to endBlock, and their results are added to node. Both
+  /// are created if null.
+  void invokeCachedReceivers(InlineCache* cache, llvm::Value* VT,
+                             std::vector<llvm::Value*>& args,
+                             llvm::Type* retType, llvm::BasicBlock*& endBlock,
+                             llvm::PHINode*& node);
+
+  /// updateInlineCache - Emit code to add the receiver to the inline cache
+  /// if the call site is not megamorphic.
+  void updateInlineCache(InlineCache* cache, llvm::Value* obj,
+                         llvm::Value* Meth);
+
+  /// recordReceiver - Emit code to add the receiver to the inline cache if
+  /// it is not in it yet.
+  void recordReceiver(InlineCache* cache, llvm::Value* VT, llvm::Value* obj,
+                      llvm::Value* Meth);
+
   /// invokeSpecial - Invoke an instance Java method directly.
   void invokeSpecial(uint16 index);
 
@@ -551,9 +601,21 @@ private:
                                    std::vector<llvm::Value*>& args);
   llvm::Instruction* lowerDoubleOps(const UTF8* name, 
                                     std::vector<llvm::Value*>& args);
+
+  /// lowerUnsafeOps - Inline the memory accesses and compare and swaps of
+  /// sun.misc.Unsafe. Returns null if the method is not inlined.
+  llvm::Value* lowerUnsafeOps(const UTF8* name,
+                              std::vector<llvm::Value*>& args,
+                              llvm::Type* retType);
+
+  /// unsafeFieldPtr - Get the address of a field, given the base object and
+  /// offset passed to sun.misc.Unsafe.
+  llvm::Value* unsafeFieldPtr(llvm::Value* base, llvm::Value* offset,
+                              llvm::Type* type);
  
-  /// lowerArraycopy - Create a fast path for System.arraycopy.
-  void lowerArraycopy(std::vector<llvm::Value*>& args);
+  /// lowerArraycopy - Create a fast path for System.arraycopy. The given
+  /// function is called for the copies that are not inlined.
+  void lowerArraycopy(std::vector<llvm::Value*>& args, llvm::Value* func);
 
   /// invoke - invoke the LLVM method of a Java method.
   llvm::Instruction* invoke(llvm::Value *F, std::vector<llvm::Value*>&args,
@@ -570,6 +632,12 @@ private:
 //===--------------------- Yield point support  ---------------------------===//
 
   void checkYieldPoint();
+
+//===--------------------- Tiered compilation support ---------------------===//
+
+  /// countHotness - Increment the given counter of the method, and promote
+  /// the method when the counter reaches the threshold.
+  void countHotness(llvm::Value* counter, uint32 threshold);
 };
 
 enum Opcode {
@@ -23,9 +23,13 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/DataLayout.h"
+#include "llvm/Target/TargetMachine.h"
 #include <lib/ExecutionEngine/JIT/JIT.h>
 
 #include "VmkitGC.h"
+#include "vmkit/Cond.h"
+#include "vmkit/Locks.h"
+#include "vmkit/Profiler.h"
 #include "vmkit/VirtualMachine.h"
 
 #include "JavaClass.h"
@@ -33,9 +37,14 @@
 #include "JavaThread.h"
 #include "JavaTypes.h"
 #include "Jnjvm.h"
+#include "JnjvmClassLoader.h"
+#include "LockedMap.h"
 
 #include "j3/JavaJITCompiler.h"
 #include "j3/J3Intrinsics.h"
+#include "j3/LLVMInfo.h"
+
+#include <map>
 
 using namespace j3;
 using namespace llvm;
@@ -49,6 +58,31 @@ void JavaJITListener::NotifyFunctionEmitted(const Function &F,
     TheCompiler->GCInfo = Details.MF->getGMI();
   }
   assert(TheCompiler->GCInfo == Details.MF->getGMI());
+
+  JavaMethod* meth = TheCompiler->getJavaMethod(F);
+  vmkit::Profiler::registerCode(Code, Size, meth);
+
+  // Promotion needs the size of the baseline code to patch its entry.
+  if (meth != NULL) {
+    LLVMMethodInfo* LMI = TheCompiler->getMethodInfo(meth);
+    if (LMI->isMethodFunction(&F)) LMI->codeSize = Size;
+  }
+
+  if (vmkit::VmkitModule::EmitPerfMap || vmkit::VmkitModule::EmitGDBSymbols) {
+    if (meth != NULL) {
+      UTF8Buffer className(meth->classDef->name);
+      UTF8Buffer methodName(meth->name);
+      UTF8Buffer signature(meth->type);
+      std::string name(className.cString());
+      name += '.';
+      name += methodName.cString();
+      name += signature.cString();
+      vmkit::VmkitModule::registerCode(name.c_str(), Code, Size);
+    } else {
+      // Stubs and runtime functions keep their LLVM name.
+      vmkit::VmkitModule::registerCode(F.getName().str().c_str(), Code, Size);
+    }
+  }
 }
 
 
@@ -162,6 +196,10 @@ JavaJITCompiler::JavaJITCompiler(
   EngineBuilder engine(TheModule);
   TargetOptions options;
   options.NoFramePointerElim = true;
+  // Baseline code is compiled with the fast instruction selector, and
+  // optimiseMethod turns it off for hot methods.
+  options.EnableFastISel =
+    TieredCompilation && !compiling_garbage_collector;
   engine.setTargetOptions(options);
   engine.setEngineKind(EngineKind::JIT);
   executionEngine = engine.create();
@@ -331,8 +369,362 @@ void JavaJITCompiler::setMethod(Function* func, void* ptr, const char* name) {
   executionEngine->updateGlobalMapping(func, ptr);
 }
 
+namespace j3 {
+
+/// CompilationRequest - A method waiting to be compiled by a compiler thread.
+/// Threads needing the same method share the same request.
+///
+class CompilationRequest {
+public:
+  static const uint32 Pending = 0;
+  static const uint32 Compiling = 1;
+  static const uint32 Done = 2;
+  static const uint32 Failed = 3;
+
+  JavaMethod* meth;
+  void* code;
+  uint32 status;
+
+  /// optimise - Whether the request is the promotion of a hot method. Nobody
+  /// waits for promotions: the compiler thread deletes them.
+  ///
+  bool optimise;
+
+  /// waiters - Number of threads waiting for the method. The last one
+  /// deletes the request.
+  ///
+  uint32 waiters;
+
+  /// next - The next request in the queue.
+  ///
+  CompilationRequest* next;
+
+  CompilationRequest(JavaMethod* m) {
+    meth = m;
+    code = NULL;
+    status = Pending;
+    waiters = 0;
+    next = NULL;
+    optimise = false;
+  }
+};
+
+/// JavaCompilerThread - A thread that compiles the methods of the compilation
+/// queue. Each compiler thread has its own compiler, hence its own LLVM
+/// context and module, so that independent methods are compiled in parallel.
+///
+class JavaCompilerThread : public JavaThread {
+public:
+  JavaJITCompiler* Compiler;
+
+  JavaCompilerThread(Jnjvm* vm) : JavaThread(vm) {
+    Compiler = NULL;
+  }
+
+  /// compilerStart - The routine of compiler threads.
+  ///
+  static void compilerStart(JavaCompilerThread* th);
+};
+
+/// CompilationQueue - The methods waiting to be compiled by compiler threads.
+/// The thread that needs a method enqueues it and only waits for that method.
+///
+class CompilationQueue {
+  /// MaxThreads - Upper bound on the number of compiler threads.
+  ///
+  static const uint32 MaxThreads = 16;
+
+  /// NumberOfThreads - Number of compiler threads.
+  ///
+  static uint32 NumberOfThreads;
+
+  /// Threads - The compiler threads.
+  ///
+  static JavaCompilerThread* Threads[MaxThreads];
+
+  /// Started - The number of compiler threads created, zero until they
+  /// are.
+  ///
+  static uint32 Started;
+
+  /// Head, Tail - The requests not picked up by a compiler thread yet.
+  ///
+  static CompilationRequest* Head;
+  static CompilationRequest* Tail;
+
+  /// PromotionHead, PromotionTail - The promotions not picked up by a
+  /// compiler thread yet. Threads are waiting for the other requests, so
+  /// promotions are only handled when there is no other request.
+  ///
+  static CompilationRequest* PromotionHead;
+  static CompilationRequest* PromotionTail;
+
+  /// Requests - The requests not finished yet, by method.
+  ///
+  static std::map<JavaMethod*, CompilationRequest*> Requests;
+
+  static vmkit::LockNormal QueueLock;
+  static vmkit::Cond WorkCond;
+  static vmkit::Cond DoneCond;
+
+public:
+
+  static void setNumberOfThreads(uint32 nb) {
+    NumberOfThreads = nb < MaxThreads ? nb : MaxThreads;
+  }
+
+  /// isCompilerThread - Is the thread a compiler thread? Compiler threads
+  /// compile the methods they need themselves.
+  ///
+  static bool isCompilerThread(vmkit::Thread* th) {
+    for (uint32 i = 0; i < Started; ++i) {
+      if (Threads[i] == th) return true;
+    }
+    return false;
+  }
+
+  /// startThreads - Create the compiler threads, if not already done.
+  ///
+  static void startThreads(Jnjvm* vm);
+
+  /// compile - Have a compiler thread compile the method, and wait for it.
+  /// Returns NULL if the method must be compiled by the current thread.
+  ///
+  static void* compile(JavaMethod* meth);
+
+  /// promote - Have a compiler thread optimise the method. Returns false if
+  /// the method must be optimised by the current thread.
+  ///
+  static bool promote(JavaMethod* meth);
+
+  /// next - Wait for a request to compile. Called by compiler threads.
+  ///
+  static CompilationRequest* next();
+
+  /// finish - Wake up the threads waiting for the request. Called by compiler
+  /// threads.
+  ///
+  static void finish(CompilationRequest* req, void* code);
+};
+
+uint32 CompilationQueue::NumberOfThreads = 0;
+JavaCompilerThread* CompilationQueue::Threads[CompilationQueue::MaxThreads];
+uint32 CompilationQueue::Started = 0;
+CompilationRequest* CompilationQueue::Head = NULL;
+CompilationRequest* CompilationQueue::Tail = NULL;
+CompilationRequest* CompilationQueue::PromotionHead = NULL;
+CompilationRequest* CompilationQueue::PromotionTail = NULL;
+std::map<JavaMethod*, CompilationRequest*> CompilationQueue::Requests;
+vmkit::LockNormal CompilationQueue::QueueLock;
+vmkit::Cond CompilationQueue::WorkCond;
+vmkit::Cond CompilationQueue::DoneCond;
+
+void CompilationQueue::startThreads(Jnjvm* vm) {
+  if (Started) return;
+  QueueLock.lock();
+  if (!Started) {
+    uint32 nbThreads = 0;
+    while (nbThreads < NumberOfThreads) {
+      // There may be no slot left for a new thread.
+      JavaCompilerThread* th = new JavaCompilerThread(vm);
+      if (th == NULL) break;
+      th->Compiler = JavaJITCompiler::CreateCompiler("Compiler thread");
+      Threads[nbThreads] = th;
+      if (th->start((void (*)(vmkit::Thread*))
+                    JavaCompilerThread::compilerStart) != 0) {
+        break;
+      }
+      ++nbThreads;
+    }
+    // Set Started after Threads, so that isCompilerThread can be called
+    // without the lock. Without compiler threads, methods are compiled by
+    // the threads that need them.
+    __sync_synchronize();
+    Started = nbThreads;
+    NumberOfThreads = nbThreads;
+  }
+  QueueLock.unlock();
+}
+
+void* CompilationQueue::compile(JavaMethod* meth) {
+  if (NumberOfThreads == 0) return NULL;
+  JavaThread* th = JavaThread::get();
+  if (isCompilerThread(th)) return NULL;
+  startThreads(th->getJVM());
+  if (NumberOfThreads == 0) return NULL;
+
+  QueueLock.lock();
+  // Another compiler may have compiled the method in the meantime.
+  void* res = meth->code;
+  if (res != NULL) {
+    QueueLock.unlock();
+    return res;
+  }
+
+  CompilationRequest* req = NULL;
+  std::map<JavaMethod*, CompilationRequest*>::iterator I = Requests.find(meth);
+  if (I != Requests.end()) {
+    req = I->second;
+  } else {
+    req = new CompilationRequest(meth);
+    Requests.insert(std::make_pair(meth, req));
+    if (Tail != NULL) Tail->next = req;
+    else Head = req;
+    Tail = req;
+    WorkCond.signal();
+  }
+
+  ++req->waiters;
+  while (req->status < CompilationRequest::Done) {
+    DoneCond.wait(&QueueLock);
+  }
+  res = (req->status == CompilationRequest::Done) ? req->code : NULL;
+  if (--req->waiters == 0) delete req;
+  QueueLock.unlock();
+  return res;
+}
+
+bool CompilationQueue::promote(JavaMethod* meth) {
+  if (NumberOfThreads == 0) return false;
+  JavaThread* th = JavaThread::get();
+  if (isCompilerThread(th)) return false;
+  startThreads(th->getJVM());
+  if (NumberOfThreads == 0) return false;
+
+  CompilationRequest* req = new CompilationRequest(meth);
+  req->optimise = true;
+  QueueLock.lock();
+  if (PromotionTail != NULL) PromotionTail->next = req;
+  else PromotionHead = req;
+  PromotionTail = req;
+  WorkCond.signal();
+  QueueLock.unlock();
+  return true;
+}
+
+CompilationRequest* CompilationQueue::next() {
+  QueueLock.lock();
+  while (Head == NULL && PromotionHead == NULL) {
+    WorkCond.wait(&QueueLock);
+  }
+  CompilationRequest* req = NULL;
+  if (Head != NULL) {
+    req = Head;
+    Head = req->next;
+    if (Head == NULL) Tail = NULL;
+  } else {
+    req = PromotionHead;
+    PromotionHead = req->next;
+    if (PromotionHead == NULL) PromotionTail = NULL;
+  }
+  req->status = CompilationRequest::Compiling;
+  QueueLock.unlock();
+  return req;
+}
+
+void CompilationQueue::finish(CompilationRequest* req, void* code) {
+  QueueLock.lock();
+  req->code = code;
+  req->status = code ? CompilationRequest::Done : CompilationRequest::Failed;
+  Requests.erase(req->meth);
+  DoneCond.broadcast();
+  QueueLock.unlock();
+}
+
+void JavaCompilerThread::compilerStart(JavaCompilerThread* th) {
+  while (true) {
+    CompilationRequest* req = CompilationQueue::next();
+    void* code = NULL;
+    TRY {
+      if (req->optimise) {
+        th->Compiler->optimiseMethod(req->meth);
+      } else {
+        code = th->Compiler->compileMethod(req->meth, NULL);
+      }
+    } CATCH {
+      // Let the thread that needs the method compile it, and get the
+      // exception. A method that fails to be optimised keeps its baseline
+      // code.
+      code = NULL;
+      th->clearException();
+    } END_CATCH;
+    if (req->optimise) {
+      delete req;
+    } else {
+      CompilationQueue::finish(req, code);
+    }
+  }
+}
+
+}
+
+void JavaJITCompiler::setNumberOfCompilerThreads(uint32 nb) {
+  CompilationQueue::setNumberOfThreads(nb);
+}
+
+void JavaJITCompiler::initialise(int argc, char** argv) {
+  static const char* kThreadsOption = "-X:jit:threads=";
+  static const int kThreadsOptionLength = strlen(kThreadsOption);
+  uint32 nbThreads = vmkit::System::GetNumberOfProcessors();
+  if (nbThreads > 4) nbThreads = 4;
+  for (int i = 1; i < argc && argv[i][0] == '-'; ++i) {
+    if (!strncmp(argv[i], kThreadsOption, kThreadsOptionLength)) {
+      nbThreads = atoi(argv[i] + kThreadsOptionLength);
+    }
+  }
+  setNumberOfCompilerThreads(nbThreads);
+
+#if defined(ARCH_X86) || defined(ARCH_X64)
+  static const char* kTieredOption = "-X:jit:tiered=";
+  static const int kTieredOptionLength = strlen(kTieredOption);
+  for (int i = 1; i < argc && argv[i][0] == '-'; ++i) {
+    if (!strncmp(argv[i], kTieredOption, kTieredOptionLength)) {
+      TieredCompilation = atoi(argv[i] + kTieredOptionLength) != 0;
+    }
+  }
+#endif
+
+  static const char* kPerfMapOption = "-X:jit:perfmap=";
+  static const int kPerfMapOptionLength = strlen(kPerfMapOption);
+  static const char* kGDBOption = "-X:jit:gdb=";
+  static const int kGDBOptionLength = strlen(kGDBOption);
+  for (int i = 1; i < argc && argv[i][0] == '-'; ++i) {
+    if (!strncmp(argv[i], kPerfMapOption, kPerfMapOptionLength)) {
+      vmkit::VmkitModule::EmitPerfMap =
+          atoi(argv[i] + kPerfMapOptionLength) != 0;
+    } else if (!strncmp(argv[i], kGDBOption, kGDBOptionLength)) {
+      vmkit::VmkitModule::EmitGDBSymbols =
+          atoi(argv[i] + kGDBOptionLength) != 0;
+    }
+  }
+  if (vmkit::VmkitModule::EmitPerfMap) vmkit::VmkitModule::openPerfMap();
+
+  static const char* kProfileFileOption = "-X:prof:file=";
+  static const int kProfileFileOptionLength = strlen(kProfileFileOption);
+  static const char* kProfileOption = "-X:prof=";
+  static const int kProfileOptionLength = strlen(kProfileOption);
+  for (int i = 1; i < argc && argv[i][0] == '-'; ++i) {
+    if (!strncmp(argv[i], kProfileFileOption, kProfileFileOptionLength)) {
+      vmkit::Profiler::OutputFile = argv[i] + kProfileFileOptionLength;
+    } else if (!strncmp(argv[i], kProfileOption, kProfileOptionLength)) {
+      vmkit::Profiler::Frequency = atoi(argv[i] + kProfileOptionLength);
+    }
+  }
+}
+
 void* JavaJITCompiler::materializeFunction(JavaMethod* meth, Class* customizeFor) {
-  vmkit::VmkitModule::protectIR();
+  // Customized versions of a method and the garbage collector are compiled
+  // by the thread that needs them.
+  if ((customizeFor == NULL || !meth->isCustomizable) &&
+      !isCompilingGarbageCollector()) {
+    void* res = CompilationQueue::compile(meth);
+    if (res != NULL) return res;
+  }
+  return compileMethod(meth, customizeFor);
+}
+
+void* JavaJITCompiler::compileMethod(JavaMethod* meth, Class* customizeFor) {
+  protectIR();
   Function* func = parseFunction(meth, customizeFor);
   void* res = executionEngine->getPointerToGlobal(func);
 
@@ -345,15 +737,163 @@ void* JavaJITCompiler::materializeFunction(JavaMethod* meth, Class* customizeFor
     // Now that it's compiled, we don't need the IR anymore
     func->deleteBody();
   }
-  vmkit::VmkitModule::unprotectIR();
+  unprotectIR();
   if (customizeFor == NULL || !getMethodInfo(meth)->isCustomizable) {
     meth->code = res;
   }
   return res;
 }
 
+// The baseline code of hot methods is patched in place, which is only
+// implemented on x86.
+#if defined(ARCH_X86) || defined(ARCH_X64)
+bool JavaJITCompiler::TieredCompilation = true;
+#else
+bool JavaJITCompiler::TieredCompilation = false;
+#endif
+
+void JavaJITCompiler::promoteMethod(JavaMethod* meth) {
+  if (!CompilationQueue::promote(meth)) {
+    optimiseMethod(meth);
+  }
+}
+
+/// EntryPatchSize - The size of the jump written at the entry of the baseline
+/// code of a promoted method.
+#if defined(ARCH_X64)
+static const size_t EntryPatchSize = 13;
+#elif defined(ARCH_X86)
+static const size_t EntryPatchSize = 5;
+#else
+static const size_t EntryPatchSize = 0;
+#endif
+
+// Whether the entry of the baseline code of a method can be overwritten by a
+// jump to its optimised code. The code must be at least as big as the jump,
+// and no call in the code may return into the jump: a thread returning there
+// would execute the middle of the jump.
+static bool CanReplaceMethodEntry(Jnjvm* vm, JavaMethod* meth, void* baseline,
+                                  size_t size) {
+  if (size < EntryPatchSize) return false;
+  word_t entry = (word_t)baseline;
+  for (word_t ip = entry; ip < entry + EntryPatchSize; ++ip) {
+    if (vm->IPToFrameInfo(ip)->Metadata == meth) return false;
+  }
+  return true;
+}
+
+// Redirect the entry of the baseline code of a method to its optimised code.
+// This way, all callers of the baseline code, including compiled code that
+// calls it directly, and virtual tables and constant pools that hold its
+// address, execute the optimised code. The entry is patched while the other
+// threads are stopped in a rendezvous: threads only join it at calls and
+// safe points, so no thread is executing the first instructions of the
+// method, which set up its frame.
+static void ReplaceMethodEntry(void* baseline, void* code) {
+  vmkit::Thread* th = vmkit::Thread::get();
+  vmkit::CollectionRV& rendezvous = th->MyVM->rendezvous;
+  while (true) {
+    rendezvous.startRV();
+    if (rendezvous.getInitiator() == NULL) break;
+    // A collection is happening, join it and try again.
+    rendezvous.cancelRV();
+    rendezvous.join();
+  }
+  rendezvous.synchronize();
+
+  uint8* entry = (uint8*)baseline;
+#if defined(ARCH_X64)
+  // movabsq $code, %r11; jmpq *%r11. %r11 is not used to pass arguments.
+  entry[0] = 0x49;
+  entry[1] = 0xBB;
+  memcpy(entry + 2, &code, sizeof(void*));
+  entry[10] = 0x41;
+  entry[11] = 0xFF;
+  entry[12] = 0xE3;
+#elif defined(ARCH_X86)
+  // jmp code
+  int32 displacement = (word_t)code - ((word_t)entry + 5);
+  entry[0] = 0xE9;
+  memcpy(entry + 1, &displacement, sizeof(int32));
+#else
+  assert(0 && "Tiered compilation not implemented on this architecture");
+#endif
+
+  rendezvous.finishRV();
+}
+
+// Replace the baseline code of a method by its optimised code in the virtual
+// tables and constant pools of the classes of the loader of the method, for
+// when its entry can not be patched. Callers that already hold the address
+// of the baseline code, e.g. in other class loaders, keep executing it.
+static void ReplaceMethodReferences(JavaMethod* meth, void* baseline,
+                                    void* code) {
+  ClassMap* classes = meth->classDef->classLoader->getClasses();
+  classes->lock.lock();
+  for (ClassMap::iterator i = classes->map.begin(), e = classes->map.end();
+       i != e; ++i) {
+    if (!i->second->isClass()) continue;
+    Class* cl = i->second->asClass();
+    if (!isStatic(meth->access) && cl->virtualVT != NULL &&
+        cl->virtualTableSize > meth->offset) {
+      word_t* VT = (word_t*)cl->virtualVT;
+      __sync_bool_compare_and_swap(&(VT[meth->offset]), (word_t)baseline,
+                                   (word_t)code);
+    }
+    JavaConstantPool* ctpInfo = cl->getConstantPool();
+    if (ctpInfo == NULL) continue;
+    for (uint32 j = 0; j < ctpInfo->ctpSize; ++j) {
+      __sync_bool_compare_and_swap(&(ctpInfo->ctpRes[j]), baseline, code);
+    }
+  }
+  classes->lock.unlock();
+}
+
+void JavaJITCompiler::optimiseMethod(JavaMethod* meth) {
+  void* baseline = meth->code;
+  if (baseline == NULL) return;
+
+  protectIR();
+  Function* func = parseOptimisedFunction(meth);
+
+  // Methods are first compiled with the fast instruction selector. Hot
+  // methods are worth the full selector.
+  TargetMachine* TM = executionEngine->getTargetMachine();
+  bool fastISel = TM->Options.EnableFastISel;
+  TM->Options.EnableFastISel = false;
+  void* res = executionEngine->getPointerToGlobal(func);
+  TM->Options.EnableFastISel = fastISel;
+
+  llvm::GCFunctionInfo& GFI = GCInfo->getFunctionInfo(*func);
+  Jnjvm* vm = JavaThread::get()->getJVM();
+  vmkit::VmkitModule::addToVM(vm, &GFI, (JIT*)executionEngine, allocator, meth);
+
+  // Now that it's compiled, we don't need the IR anymore
+  func->deleteBody();
+  size_t size = getMethodInfo(meth)->codeSize;
+  unprotectIR();
+
+  if (!CanReplaceMethodEntry(vm, meth, baseline, size)) {
+    meth->code = res;
+    ReplaceMethodReferences(meth, baseline, res);
+    return;
+  }
+
+  ReplaceMethodEntry(baseline, res);
+  meth->code = res;
+
+  // The resolution stubs now bind call sites to the optimised code. Also
+  // update the virtual table of the class of the method, so that calls
+  // through it do not go through the patched entry.
+  if (!isStatic(meth->access) && meth->classDef->virtualVT != NULL) {
+    word_t* VT = (word_t*)meth->classDef->virtualVT;
+    __sync_bool_compare_and_swap(&(VT[meth->offset]), (word_t)baseline,
+                                 (word_t)res);
+  }
+}
+
 void* JavaJITCompiler::GenerateStub(llvm::Function* F) {
-  vmkit::VmkitModule::protectIR();
+  protectIR();
   void* res = executionEngine->getPointerToGlobal(F);
  
   // If the stub was already generated through an equivalent signature,
@@ -367,7 +907,7 @@ void* JavaJITCompiler::GenerateStub(llvm::Function* F) {
     // Now that it's compiled, we don't need the IR anymore
     F->deleteBody();
   }
-  vmkit::VmkitModule::unprotectIR();
+  unprotectIR();
   return res;
 }
 
@@ -377,6 +917,7 @@ extern "C" int StartJnjvmWithJIT(int argc, char** argv, char* mainClass) {
    
   vmkit::VmkitModule::initialise(argc, argv);
   vmkit::Collector::initialise(argc, argv);
+  JavaJITCompiler::initialise(argc, argv);
  
   vmkit::ThreadAllocator allocator;
   char** newArgv = (char**)allocator.Allocate((argc + 1) * sizeof(char*));
@@ -389,8 +930,11 @@ extern "C" int StartJnjvmWithJIT(int argc, char** argv, char* mainClass) {
   JnjvmBootstrapLoader* loader = new(Allocator, "Bootstrap loader")
     JnjvmBootstrapLoader(Allocator, Comp, true);
   Jnjvm* vm = new(Allocator, "VM") Jnjvm(Allocator, NULL, loader);
+  vmkit::Profiler::start(vm);
   vm->runApplication(argc + 1, newArgv);
   vm->waitForExit();
+  // Let the exit hooks write the profile and the GC telemetry.
+  vmkit::System::Exit(0);
   
   return 0;
 }
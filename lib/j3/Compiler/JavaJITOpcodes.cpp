@@ -2569,7 +2569,7 @@ void JavaJIT::compileOpcodes(Reader& reader, uint32 codeLength) {
         bool thisReference = isThisReference(currentStackIndex - 1);
         Value* obj = pop();
         if (!thisReference) JITVerifyNull(obj);
-        monitorExit(obj);
+        monitorExit(obj, true);
         break;
       }
 
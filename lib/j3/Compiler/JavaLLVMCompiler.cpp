@@ -34,21 +34,23 @@ JavaLLVMCompiler::JavaLLVMCompiler(
   enabledException = true;
   cooperativeGC = true;
 }
+
+uint32 JavaLLVMCompiler::InvocationThreshold = 1000;
   
 void JavaLLVMCompiler::resolveVirtualClass(Class* cl) {
   // Lock here because we may be called by a class resolver
-  vmkit::VmkitModule::protectIR();
+  protectIR();
   LLVMClassInfo* LCI = (LLVMClassInfo*)getClassInfo(cl);
   LCI->getVirtualType();
-  vmkit::VmkitModule::unprotectIR();
+  unprotectIR();
 }
 
 void JavaLLVMCompiler::resolveStaticClass(Class* cl) {
   // Lock here because we may be called by a class initializer
-  vmkit::VmkitModule::protectIR();
+  protectIR();
   LLVMClassInfo* LCI = (LLVMClassInfo*)getClassInfo(cl);
   LCI->getStaticType();
-  vmkit::VmkitModule::unprotectIR();
+  unprotectIR();
 }
 
 Function* JavaLLVMCompiler::getMethod(JavaMethod* meth, Class* customizeFor) {
@@ -61,7 +63,7 @@ Function* JavaLLVMCompiler::parseFunction(JavaMethod* meth, Class* customizeFor)
   Function* func = LMI->getMethod(customizeFor);
   
   // We are jitting. Take the lock.
-  vmkit::VmkitModule::protectIR();
+  protectIR();
   if (func->getLinkage() == GlobalValue::ExternalWeakLinkage) {
     JavaJIT jit(this, meth, func, LMI->isCustomizable ? customizeFor : NULL);
     if (isNative(meth->access)) {
@@ -69,8 +71,13 @@ Function* JavaLLVMCompiler::parseFunction(JavaMethod* meth, Class* customizeFor)
       vmkit::VmkitModule::runPasses(func, JavaNativeFunctionPasses);
       vmkit::VmkitModule::runPasses(func, J3FunctionPasses);
     } else {
+      // Customized versions are only compiled for methods that are already
+      // used, so they do not go through the baseline tier.
+      jit.baseline = useTieredCompilation() &&
+          (customizeFor == NULL || !LMI->isCustomizable);
       jit.javaCompile();
-      vmkit::VmkitModule::runPasses(func, JavaFunctionPasses);
+      vmkit::VmkitModule::runPasses(func, jit.baseline ?
+          JavaBaselineFunctionPasses : JavaFunctionPasses);
       vmkit::VmkitModule::runPasses(func, J3FunctionPasses);
     }
     func->setLinkage(GlobalValue::ExternalLinkage);
@@ -82,7 +89,21 @@ Function* JavaLLVMCompiler::parseFunction(JavaMethod* meth, Class* customizeFor)
       LMI->isCustomizable = true;
     }
   }
-  vmkit::VmkitModule::unprotectIR();
+  unprotectIR();
+
+  return func;
+}
+
+Function* JavaLLVMCompiler::parseOptimisedFunction(JavaMethod* meth) {
+  assert(!isAbstract(meth->access) && !isNative(meth->access));
+  protectIR();
+  Function* func = getMethodInfo(meth)->createOptimisedMethod();
+  JavaJIT jit(this, meth, func, NULL);
+  jit.javaCompile();
+  vmkit::VmkitModule::runPasses(func, JavaOptimisingFunctionPasses);
+  vmkit::VmkitModule::runPasses(func, J3FunctionPasses);
+  func->setLinkage(GlobalValue::ExternalLinkage);
+  unprotectIR();
 
   return func;
 }
@@ -99,12 +120,15 @@ JavaLLVMCompiler::~JavaLLVMCompiler() {
   delete TheModule;
   delete DebugFactory;
   delete JavaFunctionPasses;
+  delete JavaBaselineFunctionPasses;
+  delete JavaOptimisingFunctionPasses;
   delete J3FunctionPasses;
   delete JavaNativeFunctionPasses;
   delete Context;
 }
 
 llvm::FunctionPass* createLowerConstantCallsPass(JavaLLVMCompiler* I);
+llvm::FunctionPass* createArrayBoundsCheckEliminationPass(JavaLLVMCompiler* I);
 
 void JavaLLVMCompiler::addJavaPasses() {
   JavaNativeFunctionPasses = new FunctionPassManager(TheModule);
@@ -116,6 +140,15 @@ void JavaLLVMCompiler::addJavaPasses() {
   JavaFunctionPasses = new FunctionPassManager(TheModule);
   JavaFunctionPasses->add(new DataLayout(TheModule));
   vmkit::VmkitModule::addCommandLinePasses(JavaFunctionPasses);
+
+  JavaBaselineFunctionPasses = new FunctionPassManager(TheModule);
+  JavaBaselineFunctionPasses->add(new DataLayout(TheModule));
+  vmkit::VmkitModule::addBaselinePasses(JavaBaselineFunctionPasses);
+
+  JavaOptimisingFunctionPasses = new FunctionPassManager(TheModule);
+  JavaOptimisingFunctionPasses->add(new DataLayout(TheModule));
+  vmkit::VmkitModule::addOptimisingPasses(JavaOptimisingFunctionPasses,
+      createArrayBoundsCheckEliminationPass(this));
 }
 
 } // end namespace j3
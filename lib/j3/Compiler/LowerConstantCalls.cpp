@@ -568,19 +568,14 @@ bool LowerConstantCalls::runOnFunction(Function& F) {
           PHINode* resFwd = PHINode::Create(Type::getInt32Ty(*Context), 2, "", BB7);
    
           // This corresponds to:
-          //    if (VT1.cache == VT2 || VT1 == VT2) goto end with true;
+          //    if (VT1 == VT2) goto end with true;
           //    else goto headerLoop;
-          ConstantInt* cacheIndex = 
-            ConstantInt::get(Type::getInt32Ty(*Context), JavaVirtualTable::getCacheIndex());
-          Value* indices[2] = { intrinsics->constantZero, cacheIndex };
-          Instruction* CachePtr = GetElementPtrInst::Create(VT1, indices, "", CI);
-          CachePtr = new BitCastInst(CachePtr, Ty, "", CI);
-          Value* Cache = new LoadInst(CachePtr, "", false, CI);
-          ICmpInst* cmp1 = new ICmpInst(CI, ICmpInst::ICMP_EQ, Cache, VT2, "");
-          ICmpInst* cmp2 = new ICmpInst(CI, ICmpInst::ICMP_EQ, VT1, VT2, "");
-          BinaryOperator* Or = BinaryOperator::Create(Instruction::Or, cmp1,
-                                                      cmp2, "", CI);
-          BranchInst::Create(BB9, Preheader, Or, CI);
+          // The check does not write to VT1: a shared result cache in the
+          // virtual table would bounce between the caches of the processors
+          // checking the type.
+          Value* indices[2] = { intrinsics->constantZero, NULL };
+          ICmpInst* cmp1 = new ICmpInst(CI, ICmpInst::ICMP_EQ, VT1, VT2, "");
+          BranchInst::Create(BB9, Preheader, cmp1, CI);
     
           // First test failed. Go into the loop. The Preheader looks like this:
           // headerLoop:
@@ -607,7 +602,7 @@ bool LowerConstantCalls::runOnFunction(Function& F) {
           // Here is the test if the current secondary type is VT2.
           // test:
           //   CurVT = types[i];
-          //   if (CurVT == VT2) goto update cache;
+          //   if (CurVT == VT2) goto found;
           //   est goto inc;
           Instruction* CurVT = GetElementPtrInst::Create(secondaryTypes, resFwd,
                                                          "", BB4);
@@ -633,11 +628,8 @@ bool LowerConstantCalls::runOnFunction(Function& F) {
           cmp1 = new ICmpInst(*BB7, ICmpInst::ICMP_SGT, Size, resFwd, "");
           BranchInst::Create(BB4, BB9, cmp1, BB7);
    
-          // Update the cache if the result is found.
-          // updateCache:
-          //    VT1->cache = result
+          // found:
           //    goto end with true
-          new StoreInst(VT2, CachePtr, false, BB5);
           BranchInst::Create(BB9, BB5);
 
           // Final block, that gets the result.
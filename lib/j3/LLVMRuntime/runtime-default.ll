@@ -41,7 +41,8 @@
 ;;; field 9:  void*  routine
 ;;; field 10: void*  lastKnownFrame
 ;;; field 11: void*  lastExceptionBuffer
-%Thread = type { %CircularBase, i32, i8*, i8*, i1, i1, i1, i8*, i8*, i8*, i8*, i8* }
+;;; field 12: size_t stackSize
+%Thread = type { %CircularBase, i32, i8*, i8*, i1, i1, i1, i8*, i8*, i8*, i8*, i8*, i8* }
 
 %JavaThread = type { %MutatorThread, i8*, %JavaObject* }
 
@@ -56,7 +57,7 @@
                     i16 }
 
 %JavaMethod = type { i8*, i16, %Attribute*, i16, %JavaClass*,
-                     %UTF8*, %UTF8*, i8, i8*, i32 }
+                     %UTF8*, %UTF8*, i8, i8*, i32, i32, i32, i8* }
 
 %JavaClassPrimitive = type { %JavaCommonClass, i32 }
 %JavaClassArray = type { %JavaCommonClass, %JavaCommonClass* }
@@ -250,6 +251,17 @@ declare i8* @j3ResolveSpecialStub()
 declare i8* @j3ResolveStaticStub()
 declare i8* @j3ResolveInterface(%JavaObject*, %JavaMethod*, i32)
 
+;;; j3PromoteMethod - Called by baseline code when the method becomes hot.
+declare void @j3PromoteMethod(%JavaMethod*)
+
+;;; j3InlineCacheMiss - Called when the receiver of a call site is not in the
+;;; inline cache of the call site.
+declare void @j3InlineCacheMiss(%JavaObject*, %JavaMethod*, i8*)
+
+;;; j3StaticFieldBase - Get the static instance of the placeholder object
+;;; given as base to the sun.misc.Unsafe accessors of static fields.
+declare i8* @j3StaticFieldBase(%JavaObject*) readonly
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;; Exception methods ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
@@ -0,0 +1,164 @@
+//===------ ClasspathIndex.cpp - Index of the boot class path classes ------===//
+//
+//                            The VMKit project
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include <climits>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "ClasspathIndex.h"
+#include "UTF8.h"
+#include "Zip.h"
+
+using namespace j3;
+
+static const char* ClassSuffix = ".class";
+static const uint32 ClassSuffixLength = 6;
+
+static bool isClassFile(const char* name, uint32 length) {
+  return length > ClassSuffixLength &&
+    !memcmp(name + length - ClassSuffixLength, ClassSuffix, ClassSuffixLength);
+}
+
+void ClasspathIndex::grow() {
+  uint32 newCapacity = capacity ? capacity * 2 : 1024;
+  ClasspathEntry** newTable = new ClasspathEntry*[newCapacity];
+  memset(newTable, 0, newCapacity * sizeof(ClasspathEntry*));
+  for (uint32 i = 0; i < capacity; ++i) {
+    ClasspathEntry* entry = table[i];
+    if (entry == NULL) continue;
+    uint32 index = entry->hash & (newCapacity - 1);
+    while (newTable[index] != NULL) {
+      index = (index + 1) & (newCapacity - 1);
+    }
+    newTable[index] = entry;
+  }
+  delete[] table;
+  table = newTable;
+  capacity = newCapacity;
+}
+
+void ClasspathIndex::insert(ClasspathEntry* entry) {
+  // Keep the load factor under 1/2.
+  if (2 * (size + 1) > capacity) grow();
+  uint32 index = entry->hash & (capacity - 1);
+  while (table[index] != NULL) {
+    ClasspathEntry* cur = table[index];
+    if (cur->hash == entry->hash && cur->length == entry->length &&
+        !memcmp(cur->name, entry->name, entry->length)) {
+      if (entry->rank < cur->rank) table[index] = entry;
+      return;
+    }
+    index = (index + 1) & (capacity - 1);
+  }
+  table[index] = entry;
+  ++size;
+}
+
+void ClasspathIndex::walkDirectory(const char* path, char* prefix,
+                                   uint32 prefixLength, uint32 rank,
+                                   VisitedSet& visited, uint32 depth) {
+  uint32 pathLength = strlen(path);
+  char dirName[PATH_MAX];
+  if (depth > MaxDepth) return;
+  if (pathLength + prefixLength >= PATH_MAX) return;
+  memcpy(dirName, path, pathLength);
+  memcpy(dirName + pathLength, prefix, prefixLength);
+  dirName[pathLength + prefixLength] = 0;
+
+  // Symbolic links may lead back to a directory being walked: walk each
+  // directory once.
+  struct stat dirStat;
+  if (stat(dirName, &dirStat) != 0) return;
+  if (!visited.insert(std::make_pair(dirStat.st_dev, dirStat.st_ino)).second) {
+    return;
+  }
+
+  DIR* dir = opendir(dirName);
+  if (dir == NULL) return;
+
+  struct dirent* dp = NULL;
+  while ((dp = readdir(dir)) != NULL) {
+    if (dp->d_name[0] == '.') continue;
+    uint32 length = strlen(dp->d_name);
+    uint32 nameLength = prefixLength + length;
+    // Leave room for a separator and the path of the directory.
+    if (pathLength + nameLength + 1 >= PATH_MAX) continue;
+    memcpy(prefix + prefixLength, dp->d_name, length);
+    prefix[nameLength] = 0;
+
+    bool isDir = false;
+    if (dp->d_type == DT_DIR) {
+      isDir = true;
+    } else if (dp->d_type == DT_UNKNOWN || dp->d_type == DT_LNK) {
+      struct stat st;
+      memcpy(dirName + pathLength, prefix, nameLength + 1);
+      if (stat(dirName, &st) == 0) isDir = S_ISDIR(st.st_mode);
+    }
+
+    if (isDir) {
+      prefix[nameLength] = '/';
+      walkDirectory(path, prefix, nameLength + 1, rank, visited, depth + 1);
+    } else if (isClassFile(prefix, nameLength)) {
+      ClasspathEntry* entry =
+        new(allocator, "ClasspathEntry") ClasspathEntry();
+      char* name = (char*)allocator.Allocate(nameLength + 1, "Class path name");
+      memcpy(name, prefix, nameLength + 1);
+      entry->name = name;
+      entry->length = nameLength - ClassSuffixLength;
+      entry->hash = hashFileName(name, entry->length);
+      entry->rank = rank;
+      entry->directory = path;
+      insert(entry);
+    }
+  }
+  closedir(dir);
+}
+
+void ClasspathIndex::addDirectory(const char* path, uint32 rank) {
+  char prefix[PATH_MAX];
+  prefix[0] = 0;
+  VisitedSet visited;
+  walkDirectory(path, prefix, 0, rank, visited, 0);
+}
+
+void ClasspathIndex::addArchive(ZipArchive* archive, uint32 rank) {
+  for (ZipArchive::table_iterator I = archive->begin(),
+       E = archive->end(); I != E; ++I) {
+    ZipFile* file = *I;
+    if (!isClassFile(file->filename, file->filenameLength)) continue;
+    ClasspathEntry* entry = new(allocator, "ClasspathEntry") ClasspathEntry();
+    entry->name = file->filename;
+    entry->length = file->filenameLength - ClassSuffixLength;
+    entry->hash = hashFileName(entry->name, entry->length);
+    entry->rank = rank;
+    entry->archive = archive;
+    entry->file = file;
+    insert(entry);
+  }
+}
+
+ClasspathEntry* ClasspathIndex::lookup(const UTF8* name) {
+  if (size == 0) return NULL;
+  // Class names are looked up with the low byte of each character, as they
+  // used to be when building the path of the class file.
+  uint32 hash = hashFileName(name->elements, name->size);
+  uint32 index = hash & (capacity - 1);
+  while (table[index] != NULL) {
+    ClasspathEntry* cur = table[index];
+    if (cur->hash == hash && cur->length == (uint32)name->size) {
+      sint32 i = 0;
+      while (i < name->size && cur->name[i] == (char)name->elements[i]) ++i;
+      if (i == name->size) return cur;
+    }
+    index = (index + 1) & (capacity - 1);
+  }
+  return NULL;
+}
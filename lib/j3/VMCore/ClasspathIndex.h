@@ -0,0 +1,121 @@
+//===------- ClasspathIndex.h - Index of the boot class path classes -------===//
+//
+//                            The VMKit project
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef JNJVM_CLASSPATH_INDEX_H
+#define JNJVM_CLASSPATH_INDEX_H
+
+#include <set>
+#include <utility>
+#include <sys/types.h>
+
+#include "types.h"
+
+#include "vmkit/Allocator.h"
+
+namespace vmkit {
+  class UTF8;
+}
+
+namespace j3 {
+
+class ZipArchive;
+struct ZipFile;
+
+/// ClasspathEntry - The location of a class of the boot class path.
+///
+struct ClasspathEntry : public vmkit::PermanentObject {
+  /// name - The name of the class, without the .class suffix.
+  ///
+  const char* name;
+
+  /// length - The length of the name.
+  ///
+  uint32 length;
+
+  /// hash - The hash of the name.
+  ///
+  uint32 hash;
+
+  /// rank - The position of the element of the class path holding the class.
+  /// When a class is in multiple elements, the one with the lowest rank wins.
+  ///
+  uint32 rank;
+
+  /// directory - The directory holding the class file, with a trailing
+  /// separator. Null if the class is in an archive.
+  ///
+  const char* directory;
+
+  /// archive, file - The archive holding the class, and its entry.
+  ///
+  ZipArchive* archive;
+  ZipFile* file;
+};
+
+/// ClasspathIndex - Index of the classes of the boot class path, built once
+/// when the class path is analysed. Looking up a class is a single hash probe
+/// instead of a file open for each directory of the class path.
+///
+class ClasspathIndex : public vmkit::PermanentObject {
+  vmkit::BumpPtrAllocator& allocator;
+
+  /// table - Open addressed hash table of the classes, with linear probing.
+  ///
+  ClasspathEntry** table;
+  uint32 capacity;
+  uint32 size;
+
+  /// VisitedSet - The device and inode numbers of the directories already
+  /// walked.
+  ///
+  typedef std::set<std::pair<dev_t, ino_t> > VisitedSet;
+
+  /// MaxDepth - The deepest package walked in a directory.
+  ///
+  static const uint32 MaxDepth = 64;
+
+  /// walkDirectory - Add the classes of the directory and of its
+  /// sub-directories. path is the root of the class path element, and
+  /// prefix the package of the directory, relative to it. Directories in
+  /// visited, e.g. reached again through a symbolic link, are skipped.
+  ///
+  void walkDirectory(const char* path, char* prefix, uint32 prefixLength,
+                     uint32 rank, VisitedSet& visited, uint32 depth);
+
+  void insert(ClasspathEntry* entry);
+  void grow();
+
+public:
+  ClasspathIndex(vmkit::BumpPtrAllocator& A) : allocator(A) {
+    table = NULL;
+    capacity = 0;
+    size = 0;
+  }
+
+  ~ClasspathIndex() {
+    delete[] table;
+  }
+
+  /// addDirectory - Add the classes of the directory. path must end with a
+  /// separator.
+  ///
+  void addDirectory(const char* path, uint32 rank);
+
+  /// addArchive - Add the classes of the archive.
+  ///
+  void addArchive(ZipArchive* archive, uint32 rank);
+
+  /// lookup - Find the class of the given name, or return null.
+  ///
+  ClasspathEntry* lookup(const vmkit::UTF8* name);
+};
+
+} // end namespace j3
+
+#endif
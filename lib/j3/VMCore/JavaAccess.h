@@ -37,6 +37,7 @@ namespace j3 {
 #define JNJVM_CLASS      0x10000
 #define JNJVM_ARRAY      0x20000
 #define JNJVM_PRIMITIVE  0x40000
+#define JNJVM_UNBIASABLE 0x80000
 
 #define MK_VERIFIER(name, flag)                   \
   inline bool name(unsigned int param) {          \
@@ -64,6 +65,7 @@ inline bool isVirtual(unsigned int param) {
 MK_VERIFIER(isClass,      JNJVM_CLASS)
 MK_VERIFIER(isPrimitive,  JNJVM_PRIMITIVE)
 MK_VERIFIER(isArray,      JNJVM_ARRAY)
+MK_VERIFIER(isUnbiasable, JNJVM_UNBIASABLE)
 
 
 #undef MK_VERIFIER
@@ -63,6 +63,7 @@ extern "C" void JavaObjectTracer(JavaObject*);
 extern "C" void ArrayObjectTracer(JavaObject*);
 extern "C" void RegularObjectTracer(JavaObject*);
 extern "C" void ReferenceObjectTracer(JavaObject*);
+extern "C" void NoReferenceObjectTracer(JavaObject*);
 
 
 extern "C" bool CheckIfObjectIsAssignableToArrayPosition(JavaObject * obj, JavaObject* array) {
@@ -280,6 +281,9 @@ Class::Class(JnjvmClassLoader* loader, const UTF8* n, ClassBytes* B) :
   staticFields = 0;
   ownerClass = 0;
   innerAccess = 0;
+  nbReferenceOffsets = 0;
+  referenceOffsets = 0;
+  biasRevocations = 0;
   access = JNJVM_CLASS;
   memset(IsolateInfo, 0, sizeof(TaskClassMirror) * NR_ISOLATES);
 }
@@ -551,11 +555,8 @@ bool JavaVirtualTable::isSubtypeOf(JavaVirtualTable* otherVT) {
   else if (otherVT->offset != getCacheIndex()) return false;
   else if (this == otherVT) return true;
   else {
-    for (uint32 i = 0; i < nbSecondaryTypes; ++i) {
-      if (secondaryTypes[i] == otherVT) {
-        cache = otherVT;
-        return true;
-      }
+    if (nbSecondaryTypes && getSecondaryTypeTable()->contains(otherVT)) {
+      return true;
     }
     if (cl->isArray() && otherVT->cl->isArray()) {
     	return baseClassVT->isSubtypeOf(otherVT->baseClassVT);
@@ -564,6 +565,72 @@ bool JavaVirtualTable::isSubtypeOf(JavaVirtualTable* otherVT) {
   return false;
 }
 
+/// SecondaryTableLock - Serializes the builds of the secondary type tables,
+/// so that threads racing to build a table do not leak copies of it in the
+/// allocator of the class loader.
+static vmkit::LockNormal SecondaryTableLock;
+
+SecondaryTypeTable* JavaVirtualTable::getSecondaryTypeTable() {
+  SecondaryTypeTable* table = secondaryTable;
+  if (table == NULL) {
+    SecondaryTableLock.lock();
+    table = secondaryTable;
+    if (table == NULL) {
+      table = SecondaryTypeTable::create(secondaryTypes, nbSecondaryTypes,
+                                         cl->classLoader->allocator);
+      // Readers do not lock: publish the table once it is filled.
+      __sync_synchronize();
+      secondaryTable = table;
+    }
+    SecondaryTableLock.unlock();
+  }
+  return table;
+}
+
+SecondaryTypeTable* SecondaryTypeTable::create(JavaVirtualTable** types,
+                                               uint32 nbTypes,
+                                               vmkit::BumpPtrAllocator& allocator) {
+  // Start with a load factor under 1/2, so that a collision free multiplier
+  // is usually found after a few attempts, and grow the table up to about
+  // four slots per type.
+  uint32 log = 1;
+  while ((1U << log) < 2 * nbTypes) ++log;
+  uint32 maxLog = log;
+  while ((1U << (maxLog + 1)) <= 4 * nbTypes) ++maxLog;
+
+  // Allocate the biggest table up front: attempts at smaller sizes use its
+  // first slots.
+  uint32 tableSize = sizeof(SecondaryTypeTable) +
+                     ((1U << maxLog) - 1) * sizeof(JavaVirtualTable*);
+  SecondaryTypeTable* table = (SecondaryTypeTable*)
+    allocator.Allocate(tableSize, "Secondary type table");
+  table->nbSortedTypes = 0;
+
+  for (; log <= maxLog; ++log) {
+    uint32 size = 1U << log;
+    for (uint64 attempt = 0; attempt < 16; ++attempt) {
+      table->multiplier = 0x9E3779B97F4A7C15ULL * (2 * attempt + 1);
+      table->shift = 64 - log;
+      memset(table->types, 0, size * sizeof(JavaVirtualTable*));
+      uint32 i = 0;
+      for (; i < nbTypes; ++i) {
+        uint32 index = table->getIndex(types[i]);
+        if (table->types[index] != NULL) break;
+        table->types[index] = types[i];
+      }
+      if (i == nbTypes) return table;
+    }
+  }
+
+  // No perfect hash function in that space: fall back to a binary search.
+  table->multiplier = 0;
+  table->shift = 0;
+  table->nbSortedTypes = nbTypes;
+  memcpy(table->types, types, nbTypes * sizeof(JavaVirtualTable*));
+  std::sort(table->types, table->types + nbTypes);
+  return table;
+}
+
 void JavaField::InitNullStaticField() {
   
   Typedef* type = getSignature();
@@ -690,6 +757,46 @@ void JavaMethod::initialise(Class* cl, const UTF8* N, const UTF8* T, uint16 A) {
   access = A;
   isCustomizable = false;
   offset = 0;
+  invocationCount = 0;
+  promoted = 0;
+  inlineCaches = 0;
+}
+
+InlineCache* JavaMethod::getInlineCache(uint16 bytecodeIndex) {
+  // Methods may be compiled by multiple threads at once.
+  InlineCache* res = NULL;
+  while (true) {
+    InlineCache* head = inlineCaches;
+    for (InlineCache* cur = head; cur != NULL; cur = cur->next) {
+      if (cur->bytecodeIndex == bytecodeIndex) return cur;
+    }
+    if (res == NULL) {
+      res = new(classDef->classLoader->allocator, "Inline cache")
+        InlineCache(bytecodeIndex);
+    }
+    res->next = head;
+    if (__sync_bool_compare_and_swap(&inlineCaches, head, res)) return res;
+  }
+}
+
+void InlineCache::record(JavaVirtualTable* vt, JavaMethod* callee) {
+  for (uint32 i = 0; i < NumEntries; ++i) {
+    if (methods[i] == NULL && __sync_bool_compare_and_swap(
+          &(methods[i]), (JavaMethod*)NULL, callee)) {
+      code[i] = callee->code;
+      // Compiled code reads the code of an entry once its VT matches.
+      __sync_synchronize();
+      VT[i] = vt;
+      return;
+    }
+    // The entry was claimed, maybe by a thread recording the same receiver:
+    // wait for its VT before comparing, so that the receiver does not take
+    // a second entry.
+    JavaVirtualTable* volatile* entry = &(VT[i]);
+    while (*entry == NULL) vmkit::Thread::yield();
+    if (*entry == vt) return;
+  }
+  megamorphic = 1;
 }
 
 void JavaField::initialise(Class* cl, const UTF8* N, const UTF8* T, uint16 A) {
@@ -853,6 +960,36 @@ void Class::makeVT() {
   virtualVT = new(allocator, virtualTableSize) JavaVirtualTable(this);
 }
 
+void Class::computeReferenceOffsets() {
+  uint32 nb = 0;
+  for (Class* cl = this; cl->super != NULL; cl = cl->super) {
+    for (uint32 i = 0; i < cl->nbVirtualFields; ++i) {
+      if (cl->virtualFields[i].isReference()) ++nb;
+    }
+  }
+
+  uint32* offsets = NULL;
+  if (nb != 0) {
+    offsets = (uint32*)classLoader->allocator.Allocate(nb * sizeof(uint32),
+                                                       "Reference offsets");
+    uint32 index = nb;
+    // Fields of the supers come first in the object.
+    for (Class* cl = this; cl->super != NULL; cl = cl->super) {
+      for (sint32 i = cl->nbVirtualFields - 1; i >= 0; --i) {
+        JavaField& field = cl->virtualFields[i];
+        if (field.isReference()) offsets[--index] = field.ptrOffset;
+      }
+    }
+    assert(index == 0);
+  }
+  referenceOffsets = offsets;
+  nbReferenceOffsets = nb;
+
+  if (nb == 0 && virtualVT->tracer == (word_t)RegularObjectTracer) {
+    virtualVT->tracer = (word_t)NoReferenceObjectTracer;
+  }
+}
+
 static void computeMirandaMethods(Class* current,
     Class* baseClass, std::vector<JavaMethod*>& mirandaMethods) {
   for (uint32 i = 0; i < current->nbInterfaces; i++) {
@@ -1461,6 +1598,7 @@ void ClassArray::initialiseVT(Class* javaLangObject) {
     CLASS->virtualVT->display[0] = javaLangObject->virtualVT; \
     CLASS->virtualVT->secondaryTypes = \
       upcalls->ArrayOfObject->virtualVT->secondaryTypes; \
+    CLASS->virtualVT->secondaryTable = NULL; \
 
     COPY(upcalls->ArrayOfBool)
     COPY(upcalls->ArrayOfByte)
@@ -532,6 +532,22 @@ public:
 
   uint16_t minJDKVersionMajor, minJDKVersionMinor, minJDKVersionBuild;
 
+  /// nbReferenceOffsets - The number of reference fields of instances of this
+  /// class, including inherited fields.
+  ///
+  uint32 nbReferenceOffsets;
+
+  /// referenceOffsets - The offsets of the reference fields of instances of
+  /// this class, in increasing order. Used by the tracers of the instances.
+  ///
+  uint32* referenceOffsets;
+
+  /// biasRevocations - The number of times the bias of the lock of an
+  /// instance of this class was revoked while held by another thread. Past
+  /// Jnjvm::BiasRevocationThreshold, the class is made unbiasable.
+  ///
+  uint32 biasRevocations;
+
   /// getVirtualSize - Get the virtual size of instances of this class.
   ///
   uint32 getVirtualSize() const { return virtualSize; }
@@ -820,6 +836,12 @@ public:
   ///
   void fillIMT(std::set<JavaMethod*>* meths);
 
+  /// computeReferenceOffsets - Compute the offsets of the reference fields
+  /// of instances, and select the tracer of the virtual table accordingly.
+  /// Must be called once the fields are laid out.
+  ///
+  void computeReferenceOffsets();
+
   /// makeVT - Create the virtual table of this class.
   ///
   void makeVT();
@@ -868,6 +890,55 @@ public:
   
 };
 
+/// InlineCache - The receivers seen by an invokevirtual or invokeinterface
+/// call site, and the methods they dispatch to. Compiled code compares the
+/// virtual table of the receiver with the entries of the cache before using
+/// the virtual table or the interface method table. Entries are never
+/// changed once filled: when all entries are used, the call site is
+/// megamorphic.
+///
+class InlineCache : public vmkit::PermanentObject {
+public:
+
+  /// NumEntries - Number of receivers a call site caches.
+  ///
+  static const uint32 NumEntries = 2;
+
+  /// VT - The virtual tables of the receivers, null for unused entries. Set
+  /// after the method and code of the entry.
+  ///
+  JavaVirtualTable* VT[NumEntries];
+
+  /// methods - The methods called for the receivers.
+  ///
+  JavaMethod* methods[NumEntries];
+
+  /// code - The code called for the receivers.
+  ///
+  void* code[NumEntries];
+
+  /// megamorphic - Whether the call site saw more receivers than entries.
+  ///
+  uint32 megamorphic;
+
+  /// bytecodeIndex - The index of the call in the bytecode of the method.
+  ///
+  uint16 bytecodeIndex;
+
+  /// next - The next call site of the method.
+  ///
+  InlineCache* next;
+
+  InlineCache(uint16 index) {
+    bytecodeIndex = index;
+  }
+
+  /// record - Add a receiver to the cache, or mark the call site as
+  /// megamorphic if the cache is full.
+  ///
+  void record(JavaVirtualTable* vt, JavaMethod* callee);
+};
+
 /// JavaMethod - This class represents Java methods.
 ///
 class JavaMethod : public vmkit::PermanentObject {
@@ -940,6 +1011,28 @@ public:
   ///
   uint32 offset;
 
+  /// invocationCount - The number of invocations of the baseline code of this
+  /// method.
+  ///
+  uint32 invocationCount;
+
+  /// promoted - Whether the method has been found hot, and its optimised
+  /// compilation requested.
+  ///
+  uint32 promoted;
+
+  /// inlineCaches - The inline caches of the virtual and interface call sites
+  /// of the method. The caches are shared by all compilations of the method,
+  /// so that the optimised code can call the receivers seen by the baseline
+  /// code directly.
+  ///
+  InlineCache* inlineCaches;
+
+  /// getInlineCache - Get the inline cache of the call site at the given
+  /// bytecode index, creating it if necessary.
+  ///
+  InlineCache* getInlineCache(uint16 bytecodeIndex);
+
   /// lookupAttribute - Look up an attribute in the method's attributes. Returns
   /// null if the attribute is not found.
   ///
@@ -29,47 +29,31 @@
 using namespace j3;
 using namespace std;
 
-static const int hashCodeIncrement = vmkit::GCBitMask + 1;
-uint16_t JavaObject::hashCodeGenerator = hashCodeIncrement;
-static const uint64_t HashMask = ((1 << vmkit::HashBits) - 1) << vmkit::GCBits;
-
 /// hashCode - Return the hash code of this object.
 uint32_t JavaObject::hashCode(JavaObject* self) {
   llvm_gcroot(self, 0);
   if (!vmkit::MovesObject) return (uint32_t)(long)self;
-  assert(HashMask != 0);
-  assert(vmkit::HashBits != 0);
 
+  // The object does not move while in this method: there is no safe point.
   word_t header = self->header();
-  word_t GCBits;
-  GCBits = header & vmkit::GCBitMask;
-  word_t val = header & HashMask;
-  if (val != 0) {
-    return val ^ (word_t)getClass(self);
+  word_t state = header & vmkit::HashStateMask;
+  if (state == vmkit::HashedAndMovedState) {
+    // The hash was appended to the object by the collector that moved it.
+    size_t size = JavaThread::get()->getJVM()->getObjectSize(self);
+    return *(uint32_t*)((word_t)self + vmkit::HashSlotOffset(size));
   }
-  val = hashCodeGenerator;
-  hashCodeGenerator += hashCodeIncrement;
-  val = val & HashMask;
-  if (val == 0) {
-    // It is possible that in the same time, a thread is in this method and
-    // gets the same hash code value than this thread. This is fine.
-    val = hashCodeIncrement;
-    hashCodeGenerator += hashCodeIncrement;
+
+  if (state == 0) {
+    do {
+      header = self->header();
+      if ((header & vmkit::HashStateMask) != 0) break;
+      word_t newHeader = header | vmkit::HashedState;
+      __sync_val_compare_and_swap(&(self->header()), header, newHeader);
+    } while (true);
   }
-  assert(val > vmkit::GCBitMask);
-  assert(val <= HashMask);
-
-  do {
-    header = self->header();
-    if ((header & HashMask) != 0) break;
-    word_t newHeader = header | val;
-    assert((newHeader & ~HashMask) == header);
-    __sync_val_compare_and_swap(&(self->header()), header, newHeader);
-  } while (true);
-
-  assert((self->header() & HashMask) != 0);
-  assert(GCBits == (self->header() & vmkit::GCBitMask));
-  return (self->header() & HashMask) ^ (word_t)getClass(self);
+
+  assert((self->header() & vmkit::HashStateMask) == vmkit::HashedState);
+  return vmkit::HashFromAddress((word_t)self);
 }
 
 
@@ -10,6 +10,8 @@
 #ifndef JNJVM_JAVA_OBJECT_H
 #define JNJVM_JAVA_OBJECT_H
 
+#include <algorithm>
+
 #include "vmkit/Allocator.h"
 #include "vmkit/UTF8.h"
 #include "vmkit/Locks.h"
@@ -40,6 +42,55 @@ public:
   }
 };
 
+class JavaVirtualTable;
+
+/// SecondaryTypeTable - A perfect hash table of the secondary types of a
+/// virtual table. The hash function is chosen when the table is built so that
+/// no two types share a slot: checking for a secondary type is a single probe,
+/// and never writes to memory. If no such function is found with at most
+/// about four slots per type, the table is a sorted array of the types
+/// instead.
+///
+class SecondaryTypeTable : public vmkit::PermanentObject {
+public:
+  /// multiplier - The multiplier of the hash function. Zero if the table is
+  /// a sorted array.
+  ///
+  uint64 multiplier;
+
+  /// shift - 64 minus the log2 of the number of slots.
+  ///
+  uint32 shift;
+
+  /// nbSortedTypes - The number of types of a sorted array.
+  ///
+  uint32 nbSortedTypes;
+
+  /// types - The secondary types, indexed by their hash, or sorted by
+  /// address. Empty slots are null.
+  ///
+  JavaVirtualTable* types[1];
+
+  uint32 getIndex(JavaVirtualTable* VT) {
+    return (uint32)((((uint64)(word_t)VT >> 3) * multiplier) >> shift);
+  }
+
+  /// contains - Is the given virtual table in the table?
+  ///
+  bool contains(JavaVirtualTable* VT) {
+    if (multiplier == 0) {
+      return std::binary_search(types, types + nbSortedTypes, VT);
+    }
+    return types[getIndex(VT)] == VT;
+  }
+
+  /// create - Build the table of the given types. Called once per virtual
+  /// table, since the tables are never freed.
+  ///
+  static SecondaryTypeTable* create(JavaVirtualTable** types, uint32 nbTypes,
+                                    vmkit::BumpPtrAllocator& allocator);
+};
+
 
 /// JavaVirtualTable - This class is the virtual table of instances of
 /// Java classes. Besides holding function pointers for virtual calls,
@@ -59,14 +110,15 @@ public:
   size_t depth;
 
   /// offset - Offset in the virtual table where this virtual
-  /// table may be pointed. The offset is the cache if the class
+  /// table may be pointed. The offset is the cache index if the class
   /// is an interface or depth is too big, or an offset in the display.
   ///
   size_t offset;
 
-  /// cache - The cached result for better type checks on secondary types.
+  /// secondaryTable - The hash table of the secondary types, built on the
+  /// first type check against a secondary type. Null until then.
   ///
-  JavaVirtualTable* cache;
+  SecondaryTypeTable* secondaryTable;
 
   /// display - Array of super classes.
   ///
@@ -171,7 +223,8 @@ public:
     return numberOfBaseFunctions() + 2;
   }
   
-  /// getCacheIndex - Get the word offset of the type cache.
+  /// getCacheIndex - Get the word offset of the secondary type table. It is
+  /// the offset of the types that are only found in the secondary types.
   ///
   static uint32_t getCacheIndex() {
     return numberOfBaseFunctions() + 3;
@@ -214,6 +267,11 @@ public:
   ///
   bool isSubtypeOf(JavaVirtualTable* VT);
 
+  /// getSecondaryTypeTable - Get the hash table of the secondary types,
+  /// building it if needed.
+  ///
+  SecondaryTypeTable* getSecondaryTypeTable();
+
   /// setNativeTracer - Set the tracer of this virtual table as a method
   /// defined by JnJVM.
   ///
@@ -326,8 +384,6 @@ public:
   static void decapsulePrimitive(JavaObject* self, Jnjvm* vm, jvalue* buf,
                                  const Typedef* signature);
 
-  static uint16_t hashCodeGenerator;
-
   /// hashCode - Return the hash code of this object.
   static uint32_t hashCode(JavaObject* self);
 
@@ -18,7 +18,9 @@
 #include "JavaTypes.h"
 #include "JavaUpcalls.h"
 #include "Jnjvm.h"
+#include "VMStaticInstance.h"
 
+#include "j3/JavaCompiler.h"
 #include "j3/OpcodeNames.def"
 
 #include <cstdarg>
@@ -299,9 +301,13 @@ extern "C" void j3JavaObjectAquire(JavaObject* obj) {
   JavaObject::acquire(obj);
 }
 
-// Never throws.
+// Throws if the lock of the object is not held by the current thread.
 extern "C" void j3JavaObjectRelease(JavaObject* obj) {
   llvm_gcroot(obj, 0);
+  if (!JavaObject::owner(obj)) {
+    JavaThread::get()->getJVM()->illegalMonitorStateException(obj);
+    UNREACHABLE();
+  }
   JavaObject::release(obj);
 }
 
@@ -530,6 +536,66 @@ extern "C" void* j3ResolveInterface(JavaObject* obj, JavaMethod* meth, uint32_t
   return (void*)result;
 }
 
+/// lookupVirtualTableSlot - The method whose code is at the given offset of
+/// the virtual table of the class, i.e. the method the class defines or
+/// inherits at that offset.
+static JavaMethod* lookupVirtualTableSlot(UserClass* cl, uint32 offset) {
+  for (; cl != NULL; cl = cl->super) {
+    for (uint32 i = 0; i < cl->nbVirtualMethods; ++i) {
+      JavaMethod* meth = &(cl->virtualMethods[i]);
+      if (meth->offset == offset && !isStatic(meth->access)) return meth;
+    }
+  }
+  return NULL;
+}
+
+// Does not throw an exception.
+extern "C" void j3InlineCacheMiss(JavaObject* obj, JavaMethod* meth,
+                                  InlineCache* cache) {
+  llvm_gcroot(obj, 0);
+  UserCommonClass* cl = JavaObject::getClass(obj);
+  UserClass* lookup = cl->isArray() ? cl->super : cl->asClass();
+  JavaMethod* callee = NULL;
+  if (isInterface(meth->classDef->access)) {
+    // The method the interface method table of the class dispatches to, see
+    // JavaJITCompiler::makeIMT.
+    callee = lookup->lookupMethodDontThrow(meth->name, meth->type,
+                                           false, true, NULL);
+  } else {
+    // The method the virtual table of the receiver dispatches to.
+    callee = lookupVirtualTableSlot(lookup, meth->offset);
+  }
+  // Leave errors to the usual dispatch.
+  if (callee == NULL || isAbstract(callee->access)) return;
+
+  if (callee->code == NULL) {
+    // Compile the callee now, as the usual dispatch would right after this
+    // call. Otherwise the call site would miss until another call site
+    // compiles the callee.
+    TRY {
+      callee->compiledPtr(lookup);
+    } IGNORE;
+    if (callee->code == NULL) return;
+  }
+  cache->record(obj->getVirtualTable(), callee);
+}
+
+// Does not throw an exception.
+extern "C" void* j3StaticFieldBase(JavaObject* base) {
+  llvm_gcroot(base, 0);
+  assert(VMStaticInstance::isVMStaticInstance(base));
+  return ((VMStaticInstance*)base)->getStaticInstance();
+}
+
+// Does not throw an exception.
+extern "C" void j3PromoteMethod(JavaMethod* meth) {
+  // Baseline code may reach the threshold in multiple threads: only
+  // promote the method once.
+  if (__sync_bool_compare_and_swap(&(meth->promoted), 0, 1)) {
+    meth->classDef->classLoader->getCompiler()->promoteMethod(meth);
+  }
+}
+
 #if JNJVM_EXECUTE > 0
 std::map<void*, int> debugTabulations;
 std::map<void*, int>::iterator last = debugTabulations.end();
@@ -120,4 +120,127 @@ const UTF8* JavaString::javaToInternal(const JavaString* self, UTF8Map* map) {
   return res;
 }
 
+uint32 StringMap::hash(const uint16* chars, sint32 length) {
+  uint32 hash = 0;
+  for (sint32 i = 0; i < length; ++i) {
+    hash = 31 * hash + chars[i];
+  }
+  return hash;
+}
+
+JavaString* StringMap::lookup(Stripe& stripe, uint32 hash,
+                              const uint16* chars, sint32 length) {
+  JavaString* cur = NULL;
+  llvm_gcroot(cur, 0);
+  if (stripe.size == 0) return NULL;
+  uint32 index = mix(hash) & (stripe.capacity - 1);
+  while (stripe.table[index].string != NULL) {
+    cur = stripe.table[index].string;
+    if (stripe.table[index].hash == hash && cur->count == length &&
+        !memcmp(ArrayUInt16::getElements(JavaString::getValue(cur)) +
+                cur->offset, chars, length * sizeof(uint16))) {
+      return cur;
+    }
+    index = (index + 1) & (stripe.capacity - 1);
+  }
+  return NULL;
+}
+
+void StringMap::grow(Stripe& stripe) {
+  Entry* oldTable = stripe.table;
+  uint32 oldCapacity = stripe.capacity;
+  stripe.capacity = oldCapacity ? oldCapacity * 2 : 64;
+  stripe.table = new Entry[stripe.capacity];
+  memset(stripe.table, 0, stripe.capacity * sizeof(Entry));
+  stripe.size = 0;
+  for (uint32 i = 0; i < oldCapacity; ++i) {
+    if (oldTable[i].string != NULL) {
+      insert(stripe, oldTable[i].hash, oldTable[i].string);
+    }
+  }
+  delete[] oldTable;
+}
+
+void StringMap::insert(Stripe& stripe, uint32 hash, JavaString* str) {
+  llvm_gcroot(str, 0);
+  // Keep the load factor under 1/2.
+  if (2 * (stripe.size + 1) > stripe.capacity) grow(stripe);
+  uint32 index = mix(hash) & (stripe.capacity - 1);
+  while (stripe.table[index].string != NULL) {
+    index = (index + 1) & (stripe.capacity - 1);
+  }
+  stripe.table[index].hash = hash;
+  stripe.table[index].string = str;
+  ++stripe.size;
+}
+
+JavaString* StringMap::lookup(JavaString* str) {
+  JavaString* res = NULL;
+  llvm_gcroot(str, 0);
+  llvm_gcroot(res, 0);
+  const uint16* chars =
+    ArrayUInt16::getElements(JavaString::getValue(str)) + str->offset;
+  uint32 h = hash(chars, str->count);
+  Stripe& stripe = getStripe(h);
+
+  stripe.lock.lock();
+  // A collection may have happened while waiting for the lock.
+  chars = ArrayUInt16::getElements(JavaString::getValue(str)) + str->offset;
+  res = lookup(stripe, h, chars, str->count);
+  stripe.lock.unlock();
+  return res;
+}
+
+JavaString* StringMap::intern(JavaString* str) {
+  JavaString* res = NULL;
+  llvm_gcroot(str, 0);
+  llvm_gcroot(res, 0);
+  const uint16* chars =
+    ArrayUInt16::getElements(JavaString::getValue(str)) + str->offset;
+  uint32 h = hash(chars, str->count);
+  Stripe& stripe = getStripe(h);
+
+  stripe.lock.lock();
+  // A collection may have happened while waiting for the lock.
+  chars = ArrayUInt16::getElements(JavaString::getValue(str)) + str->offset;
+  res = lookup(stripe, h, chars, str->count);
+  if (res == NULL) {
+    insert(stripe, h, str);
+    res = str;
+  }
+  stripe.lock.unlock();
+  return res;
+}
+
+void StringMap::scan(word_t closure) {
+  gc* str = NULL;
+  llvm_gcroot(str, 0);
+  for (uint32 i = 0; i < NbStripes; ++i) {
+    Stripe& stripe = stripes[i];
+    if (stripe.size == 0) continue;
+
+    // Keep the live strings, then put them back in the emptied table: their
+    // slots may change once dead strings are removed.
+    Entry* live = new Entry[stripe.size];
+    uint32 nbLive = 0;
+    for (uint32 j = 0; j < stripe.capacity; ++j) {
+      str = (gc*)stripe.table[j].string;
+      if (str == NULL) continue;
+      if (vmkit::Collector::isLive(str, closure)) {
+        live[nbLive].hash = stripe.table[j].hash;
+        live[nbLive].string =
+          (JavaString*)vmkit::Collector::getForwardedReferent(str, closure);
+        ++nbLive;
+      }
+    }
+
+    memset(stripe.table, 0, stripe.capacity * sizeof(Entry));
+    stripe.size = 0;
+    for (uint32 j = 0; j < nbLive; ++j) {
+      insert(stripe, live[j].hash, live[j].string);
+    }
+    delete[] live;
+  }
+}
+
 }
@@ -3351,67 +3351,91 @@ jdoubleArray NewDoubleArray(JNIEnv *env, jsize len) {
 }
 
 
-jboolean* GetBooleanArrayElements(JNIEnv *env, jbooleanArray _array,
-				                          jboolean *isCopy) {
-  ArrayUInt8* array = 0;
+/// getArrayElements - Hand out the elements of a primitive array to native
+/// code. The elements are not copied if the collector can pin the array.
+static void* getArrayElements(JavaObject* array, uint32 logSize,
+                              jboolean* isCopy) {
   llvm_gcroot(array, 0);
-  
-  BEGIN_JNI_EXCEPTION
- 
-  // Local object references.
-  array = *(ArrayUInt8**)_array;
 
-  if (isCopy) (*isCopy) = true;
+  if (vmkit::Collector::pinObject(array)) {
+    if (isCopy) (*isCopy) = false;
+    return JavaArray::getElements(array);
+  }
 
-  sint32 len = ArrayUInt8::getSize(array) * sizeof(uint8);
+  if (isCopy) (*isCopy) = true;
+  sint32 len = JavaArray::getSize(array) << logSize;
   void* buffer = malloc(len);
-  memcpy(buffer, ArrayUInt8::getElements(array), len);
+  memcpy(buffer, JavaArray::getElements(array), len);
+  return buffer;
+}
 
-  RETURN_FROM_JNI((jboolean*)buffer);
 
-  END_JNI_EXCEPTION
-  RETURN_FROM_JNI(0);
+/// releaseArrayElements - Release elements returned by getArrayElements,
+/// copying them back to the array unless mode is JNI_ABORT.
+static void releaseArrayElements(JavaObject* array, uint32 logSize,
+                                 void* elems, jint mode) {
+  llvm_gcroot(array, 0);
+
+  // The array was pinned: native code wrote directly to it.
+  if (elems == JavaArray::getElements(array)) return;
+
+  if (mode != JNI_ABORT) {
+    sint32 len = JavaArray::getSize(array) << logSize;
+    memcpy(JavaArray::getElements(array), elems, len);
+  }
+
+  if (mode != JNI_COMMIT) free(elems);
 }
 
 
-jbyte *GetByteArrayElements(JNIEnv *env, jbyteArray _array, jboolean *isCopy) {
-  ArraySInt8* array = 0;
+jboolean *GetBooleanArrayElements(JNIEnv *env, jbooleanArray _array,
+                                   jboolean *isCopy) {
+  JavaObject* array = 0;
   llvm_gcroot(array, 0);
 
   BEGIN_JNI_EXCEPTION
 
   // Local object references.
-  array = *(ArraySInt8**)_array;
-
-  if (isCopy) (*isCopy) = true;
-
-  sint32 len = ArraySInt8::getSize(array) * sizeof(uint8);
-  void* buffer = malloc(len);
-  memcpy(buffer, ArraySInt8::getElements(array), len);
+  array = *(JavaObject**)_array;
 
-  RETURN_FROM_JNI((jbyte*)buffer);
+  jboolean* res = (jboolean*)getArrayElements(array, 0, isCopy);
+  RETURN_FROM_JNI(res);
 
   END_JNI_EXCEPTION
   RETURN_FROM_JNI(0);
 }
 
 
-jchar *GetCharArrayElements(JNIEnv *env, jcharArray _array, jboolean *isCopy) {
-  ArrayUInt16* array = 0;
+jbyte *GetByteArrayElements(JNIEnv *env, jbyteArray _array,
+                             jboolean *isCopy) {
+  JavaObject* array = 0;
   llvm_gcroot(array, 0);
 
   BEGIN_JNI_EXCEPTION
-  
+
   // Local object references.
-  array = *(ArrayUInt16**)_array;
+  array = *(JavaObject**)_array;
 
-  if (isCopy) (*isCopy) = true;
+  jbyte* res = (jbyte*)getArrayElements(array, 0, isCopy);
+  RETURN_FROM_JNI(res);
 
-  sint32 len = ArrayUInt16::getSize(array) * sizeof(uint16);
-  void* buffer = malloc(len);
-  memcpy(buffer, ArrayUInt16::getElements(array), len);
+  END_JNI_EXCEPTION
+  RETURN_FROM_JNI(0);
+}
+
+
+jchar *GetCharArrayElements(JNIEnv *env, jcharArray _array,
+                             jboolean *isCopy) {
+  JavaObject* array = 0;
+  llvm_gcroot(array, 0);
+
+  BEGIN_JNI_EXCEPTION
+
+  // Local object references.
+  array = *(JavaObject**)_array;
 
-  RETURN_FROM_JNI((jchar*)buffer);
+  jchar* res = (jchar*)getArrayElements(array, 1, isCopy);
+  RETURN_FROM_JNI(res);
 
   END_JNI_EXCEPTION
   RETURN_FROM_JNI(0);
@@ -3419,66 +3443,53 @@ jchar *GetCharArrayElements(JNIEnv *env, jcharArray _array, jboolean *isCopy) {
 
 
 jshort *GetShortArrayElements(JNIEnv *env, jshortArray _array,
-                              jboolean *isCopy) {
-  ArraySInt16* array = 0;
+                               jboolean *isCopy) {
+  JavaObject* array = 0;
   llvm_gcroot(array, 0);
-  
+
   BEGIN_JNI_EXCEPTION
-  
-  // Local object references.
-  array = *(ArraySInt16**)_array;
-  
-  if (isCopy) (*isCopy) = true;
 
-  sint32 len = ArraySInt16::getSize(array) * sizeof(sint16);
-  void* buffer = malloc(len);
-  memcpy(buffer, ArraySInt16::getElements(array), len);
+  // Local object references.
+  array = *(JavaObject**)_array;
 
-  RETURN_FROM_JNI((jshort*)buffer);
+  jshort* res = (jshort*)getArrayElements(array, 1, isCopy);
+  RETURN_FROM_JNI(res);
 
   END_JNI_EXCEPTION
   RETURN_FROM_JNI(0);
 }
 
 
-jint *GetIntArrayElements(JNIEnv *env, jintArray _array, jboolean *isCopy) {
-  ArraySInt32* array = 0;
+jint *GetIntArrayElements(JNIEnv *env, jintArray _array,
+                           jboolean *isCopy) {
+  JavaObject* array = 0;
   llvm_gcroot(array, 0);
 
   BEGIN_JNI_EXCEPTION
-  
-  // Local object references.
-  array = *(ArraySInt32**)_array;
-
-  if (isCopy) (*isCopy) = true;
 
-  sint32 len = ArraySInt32::getSize(array) * sizeof(sint32);
-  void* buffer = malloc(len);
-  memcpy(buffer, ArraySInt32::getElements(array), len);
+  // Local object references.
+  array = *(JavaObject**)_array;
 
-  RETURN_FROM_JNI((jint*)buffer);
+  jint* res = (jint*)getArrayElements(array, 2, isCopy);
+  RETURN_FROM_JNI(res);
 
   END_JNI_EXCEPTION
   RETURN_FROM_JNI(0);
 }
 
 
-jlong *GetLongArrayElements(JNIEnv *env, jlongArray _array, jboolean *isCopy) {
-  ArrayLong* array = 0;
+jlong *GetLongArrayElements(JNIEnv *env, jlongArray _array,
+                             jboolean *isCopy) {
+  JavaObject* array = 0;
   llvm_gcroot(array, 0);
 
   BEGIN_JNI_EXCEPTION
-  
-  // Local object references.
-  array = *(ArrayLong**)_array;
 
-  if (isCopy) (*isCopy) = true;
-
-  sint32 len = ArrayLong::getSize(array) * sizeof(sint64);
-  void* buffer = malloc(len);
-  memcpy(buffer, ArrayLong::getElements(array), len);
+  // Local object references.
+  array = *(JavaObject**)_array;
 
-  RETURN_FROM_JNI((jlong*)buffer);
+  jlong* res = (jlong*)getArrayElements(array, 3, isCopy);
+  RETURN_FROM_JNI(res);
 
   END_JNI_EXCEPTION
   RETURN_FROM_JNI(0);
@@ -3486,22 +3497,17 @@ jlong *GetLongArrayElements(JNIEnv *env, jlongArray _array, jboolean *isCopy) {
 
 
 jfloat *GetFloatArrayElements(JNIEnv *env, jfloatArray _array,
-                              jboolean *isCopy) {
-  ArrayFloat* array = 0;
+                               jboolean *isCopy) {
+  JavaObject* array = 0;
   llvm_gcroot(array, 0);
 
   BEGIN_JNI_EXCEPTION
-  
-  // Local object references.
-  array = *(ArrayFloat**)_array;
-
-  if (isCopy) (*isCopy) = true;
 
-  sint32 len = ArrayFloat::getSize(array) * sizeof(float);
-  void* buffer = malloc(len);
-  memcpy(buffer, ArrayFloat::getElements(array), len);
+  // Local object references.
+  array = *(JavaObject**)_array;
 
-  RETURN_FROM_JNI((jfloat*)buffer);
+  jfloat* res = (jfloat*)getArrayElements(array, 2, isCopy);
+  RETURN_FROM_JNI(res);
 
   END_JNI_EXCEPTION
   RETURN_FROM_JNI(0);
@@ -3509,22 +3515,17 @@ jfloat *GetFloatArrayElements(JNIEnv *env, jfloatArray _array,
 
 
 jdouble *GetDoubleArrayElements(JNIEnv *env, jdoubleArray _array,
-				jboolean *isCopy) {
-  ArrayDouble* array = 0;
+                                 jboolean *isCopy) {
+  JavaObject* array = 0;
   llvm_gcroot(array, 0);
-  
+
   BEGIN_JNI_EXCEPTION
-  
-  // Local object references.
-  array = *(ArrayDouble**)_array;
-  
-  if (isCopy) (*isCopy) = true;
 
-  sint32 len = ArrayDouble::getSize(array) * sizeof(double);
-  void* buffer = malloc(len);
-  memcpy(buffer, ArrayDouble::getElements(array), len);
+  // Local object references.
+  array = *(JavaObject**)_array;
 
-  RETURN_FROM_JNI((jdouble*)buffer);
+  jdouble* res = (jdouble*)getArrayElements(array, 3, isCopy);
+  RETURN_FROM_JNI(res);
 
   END_JNI_EXCEPTION
   RETURN_FROM_JNI(0);
@@ -3532,193 +3533,129 @@ jdouble *GetDoubleArrayElements(JNIEnv *env, jdoubleArray _array,
 
 
 void ReleaseBooleanArrayElements(JNIEnv *env, jbooleanArray _array,
-				 jboolean *elems, jint mode) {
-  ArrayUInt8* array = 0;
+                                 jboolean *elems, jint mode) {
+  JavaObject* array = 0;
   llvm_gcroot(array, 0);
-  
+
   BEGIN_JNI_EXCEPTION
-  
-  array = *(ArrayUInt8**)_array;
-  
-  if (mode == JNI_ABORT) {
-    free(elems);
-  } else {
-    sint32 len = ArrayUInt8::getSize(array);
-    memcpy(ArrayUInt8::getElements(array), elems, len);
 
-    if (mode == 0) free(elems);
-  }
-  
+  array = *(JavaObject**)_array;
+  releaseArrayElements(array, 0, elems, mode);
+
   END_JNI_EXCEPTION
-  
+
   RETURN_VOID_FROM_JNI;
 }
 
 
 void ReleaseByteArrayElements(JNIEnv *env, jbyteArray _array, jbyte *elems,
-			      jint mode) {
-  ArraySInt16* array = 0;
+                              jint mode) {
+  JavaObject* array = 0;
   llvm_gcroot(array, 0);
-  
+
   BEGIN_JNI_EXCEPTION
 
-  array = *(ArraySInt16**)_array;
-  
-  if (mode == JNI_ABORT) {
-    free(elems);
-  } else {
-    sint32 len = ArraySInt16::getSize(array);
-    memcpy(ArraySInt16::getElements(array), elems, len);
+  array = *(JavaObject**)_array;
+  releaseArrayElements(array, 0, elems, mode);
 
-    if (mode == 0) free(elems);
-  }
-  
   END_JNI_EXCEPTION
-  
+
   RETURN_VOID_FROM_JNI;
 }
 
 
 void ReleaseCharArrayElements(JNIEnv *env, jcharArray _array, jchar *elems,
-			      jint mode) {
-  ArrayUInt16* array = 0;
+                              jint mode) {
+  JavaObject* array = 0;
   llvm_gcroot(array, 0);
-  
-  BEGIN_JNI_EXCEPTION
 
-  array = *(ArrayUInt16**)_array;
+  BEGIN_JNI_EXCEPTION
 
-  if (mode == JNI_ABORT) {
-    free(elems);
-  } else {
-    sint32 len = ArrayUInt16::getSize(array) << 1;
-    memcpy(ArrayUInt16::getElements(array), elems, len);
+  array = *(JavaObject**)_array;
+  releaseArrayElements(array, 1, elems, mode);
 
-    if (mode == 0) free(elems);
-  }
-  
   END_JNI_EXCEPTION
-  
+
   RETURN_VOID_FROM_JNI;
 }
 
 
 void ReleaseShortArrayElements(JNIEnv *env, jshortArray _array, jshort *elems,
-			       jint mode) {
-  ArraySInt16* array = 0;
+                               jint mode) {
+  JavaObject* array = 0;
   llvm_gcroot(array, 0);
-  
+
   BEGIN_JNI_EXCEPTION
 
-  array = *(ArraySInt16**)_array;
-  
-  if (mode == JNI_ABORT) {
-    free(elems);
-  } else {
-    sint32 len = ArraySInt16::getSize(array) << 1;
-    memcpy(ArraySInt16::getElements(array), elems, len);
+  array = *(JavaObject**)_array;
+  releaseArrayElements(array, 1, elems, mode);
 
-    if (mode == 0) free(elems);
-  }
-  
   END_JNI_EXCEPTION
-  
+
   RETURN_VOID_FROM_JNI;
 }
 
 
 void ReleaseIntArrayElements(JNIEnv *env, jintArray _array, jint *elems,
-			     jint mode) {
-  ArraySInt32* array = 0;
+                             jint mode) {
+  JavaObject* array = 0;
   llvm_gcroot(array, 0);
-  
+
   BEGIN_JNI_EXCEPTION
-    
-  array = *(ArraySInt32**)_array;
-  
-  if (mode == JNI_ABORT) {
-    free(elems);
-  } else {
-    sint32 len = ArraySInt32::getSize(array) << 2;
-    memcpy(ArraySInt32::getElements(array), elems, len);
 
-    if (mode == 0) free(elems);
-  }
-  
+  array = *(JavaObject**)_array;
+  releaseArrayElements(array, 2, elems, mode);
+
   END_JNI_EXCEPTION
-  
+
   RETURN_VOID_FROM_JNI;
 }
 
 
 void ReleaseLongArrayElements(JNIEnv *env, jlongArray _array, jlong *elems,
-			      jint mode) {
-  ArrayLong* array = 0;
+                              jint mode) {
+  JavaObject* array = 0;
   llvm_gcroot(array, 0);
-  
+
   BEGIN_JNI_EXCEPTION
-    
-  array = *(ArrayLong**)_array;
-  
-  if (mode == JNI_ABORT) {
-    free(elems);
-  } else {
-    sint32 len = ArrayLong::getSize(array) << 3;
-    memcpy(ArrayLong::getElements(array), elems, len);
 
-    if (mode == 0) free(elems);
-  }
-  
+  array = *(JavaObject**)_array;
+  releaseArrayElements(array, 3, elems, mode);
+
   END_JNI_EXCEPTION
-  
+
   RETURN_VOID_FROM_JNI;
 }
 
 
 void ReleaseFloatArrayElements(JNIEnv *env, jfloatArray _array, jfloat *elems,
-			       jint mode) {
-  ArrayFloat* array = 0;
+                               jint mode) {
+  JavaObject* array = 0;
   llvm_gcroot(array, 0);
 
   BEGIN_JNI_EXCEPTION
-    
-  array = *(ArrayFloat**)_array;
-  
-  if (mode == JNI_ABORT) {
-    free(elems);
-  } else {
-    sint32 len = ArrayFloat::getSize(array) << 2;
-    memcpy(ArrayFloat::getElements(array), elems, len);
 
-    if (mode == 0) free(elems);
-  }
-  
+  array = *(JavaObject**)_array;
+  releaseArrayElements(array, 2, elems, mode);
+
   END_JNI_EXCEPTION
-  
+
   RETURN_VOID_FROM_JNI;
 }
 
 
-void ReleaseDoubleArrayElements(JNIEnv *env, jdoubleArray _array,
-				jdouble *elems, jint mode) {
-  ArrayDouble* array = 0;
+void ReleaseDoubleArrayElements(JNIEnv *env, jdoubleArray _array, jdouble *elems,
+                                jint mode) {
+  JavaObject* array = 0;
   llvm_gcroot(array, 0);
-  
+
   BEGIN_JNI_EXCEPTION
-    
-  array = *(ArrayDouble**)_array;
-  
-  if (mode == JNI_ABORT) {
-    free(elems);
-  } else {
-    sint32 len = ArrayDouble::getSize(array) << 3;
-    memcpy(ArrayDouble::getElements(array), elems, len);
 
-    if (mode == 0) free(elems);
-  }
-  
+  array = *(JavaObject**)_array;
+  releaseArrayElements(array, 3, elems, mode);
+
   END_JNI_EXCEPTION
-  
+
   RETURN_VOID_FROM_JNI;
 }
 
@@ -4144,15 +4081,10 @@ void *GetPrimitiveArrayCritical(JNIEnv *env, jarray _array, jboolean *isCopy) {
   
   array = *(JavaObject**)_array;
 
-  if (isCopy) (*isCopy) = true;
-
   UserClassArray* cl = JavaObject::getClass(array)->asArrayClass();
   uint32 logSize = cl->baseClass()->asPrimitiveClass()->logSize;
-  sint32 len = JavaArray::getSize(array) << logSize;
-  void* buffer = malloc(len);
-  memcpy(buffer, JavaArray::getElements(array), len);
-
-  RETURN_FROM_JNI((jchar*)buffer);
+  void* res = getArrayElements(array, logSize, isCopy);
+  RETURN_FROM_JNI(res);
 
   END_JNI_EXCEPTION
   RETURN_FROM_JNI(0);
@@ -4168,16 +4100,9 @@ void ReleasePrimitiveArrayCritical(JNIEnv *env, jarray _array, void *carray,
   
   array = *(JavaObject**)_array;
 
-  if (mode == JNI_ABORT) {
-    free(carray);
-  } else {
-    UserClassArray* cl = JavaObject::getClass(array)->asArrayClass();
-    uint32 logSize = cl->baseClass()->asPrimitiveClass()->logSize;
-    sint32 len = JavaArray::getSize(array) << logSize;
-    memcpy(JavaArray::getElements(array), carray, len);
-
-    if (mode == 0) free(carray);
-  }
+  UserClassArray* cl = JavaObject::getClass(array)->asArrayClass();
+  uint32 logSize = cl->baseClass()->asPrimitiveClass()->logSize;
+  releaseArrayElements(array, logSize, carray, mode);
   
   END_JNI_EXCEPTION
   
@@ -4185,16 +4110,53 @@ void ReleasePrimitiveArrayCritical(JNIEnv *env, jarray _array, void *carray,
 }
 
 
-const jchar *GetStringCritical(JNIEnv *env, jstring string, jboolean *isCopy) {
-  NYI();
-  abort();
-  return 0;
+const jchar *GetStringCritical(JNIEnv *env, jstring _string, jboolean *isCopy) {
+  JavaString* string = 0;
+  const ArrayUInt16* value = 0;
+  llvm_gcroot(string, 0);
+  llvm_gcroot(value, 0);
+
+  BEGIN_JNI_EXCEPTION
+
+  string = *(JavaString**)_string;
+  value = JavaString::getValue(string);
+
+  if (vmkit::Collector::pinObject((gc*)value)) {
+    if (isCopy) (*isCopy) = false;
+    const jchar* res = ArrayUInt16::getElements(value) + string->offset;
+    RETURN_FROM_JNI(res);
+  }
+
+  if (isCopy) (*isCopy) = true;
+  sint32 len = string->count << 1;
+  jchar* buffer = (jchar*)malloc(len);
+  memcpy(buffer, ArrayUInt16::getElements(value) + string->offset, len);
+  RETURN_FROM_JNI(buffer);
+
+  END_JNI_EXCEPTION
+  RETURN_FROM_JNI(0);
 }
 
 
-void ReleaseStringCritical(JNIEnv *env, jstring string, const jchar *cstring) {
-  NYI();
-  abort();
+void ReleaseStringCritical(JNIEnv *env, jstring _string, const jchar *cstring) {
+  JavaString* string = 0;
+  const ArrayUInt16* value = 0;
+  llvm_gcroot(string, 0);
+  llvm_gcroot(value, 0);
+
+  BEGIN_JNI_EXCEPTION
+
+  string = *(JavaString**)_string;
+  value = JavaString::getValue(string);
+
+  // Strings are immutable: only copies need to be released.
+  if (cstring != ArrayUInt16::getElements(value) + string->offset) {
+    free((void*)cstring);
+  }
+
+  END_JNI_EXCEPTION
+
+  RETURN_VOID_FROM_JNI;
 }
 
 /// FIXME : I copied the code of strong references. We need to implement real
@@ -43,6 +43,7 @@ using namespace j3;
 const char* Jnjvm::dirSeparator = "/";
 const char* Jnjvm::envSeparator = ":";
 const unsigned int Jnjvm::Magic = 0xcafebabe;
+const uint32 Jnjvm::BiasRevocationThreshold = 40;
 
 /**
  * In JVM specification, the virtual machine should execute some code when
@@ -764,13 +765,31 @@ JavaString* Jnjvm::constructString(const ArrayUInt16* array) {
   llvm_gcroot(key, 0);
   key = JavaString::create(array, this);
   if (upcalls->internString) {
-    return (JavaString*)upcalls->internString->invokeJavaObjectStatic(
-        this, upcalls->internString->classDef, &key);
+    return internedStrings.intern(key);
   } else {
     return key;
   }
 }
 
+JavaString* Jnjvm::internString(JavaString* str) {
+  JavaString* res = NULL;
+  const ArrayUInt16* array = NULL;
+  llvm_gcroot(str, 0);
+  llvm_gcroot(res, 0);
+  llvm_gcroot(array, 0);
+
+  res = internedStrings.lookup(str);
+  if (res != NULL) return res;
+
+  // Do not keep alive the characters of the array the string does not use.
+  if (str->offset != 0 ||
+      str->count != ArrayUInt16::getSize(JavaString::getValue(str))) {
+    array = JavaString::strToArray(str, this);
+    str = JavaString::create(array, this);
+  }
+  return internedStrings.intern(str);
+}
+
 JavaString* Jnjvm::asciizToStr(const char* asciiz) {
   ArrayUInt16* var = NULL;
   llvm_gcroot(var, 0);
@@ -861,26 +880,25 @@ static char* findInformation(Jnjvm* vm, ClassBytes* manifest, const char* entry,
 
 void ClArgumentsInfo::extractClassFromJar(Jnjvm* vm, int argc, char** argv, 
                                           int i) {
-  ClassBytes* bytes = NULL;
   ClassBytes* res = NULL;
   jarFile = argv[i];
 
   vm->setClasspath(jarFile);
   
-  bytes = Reader::openFile(vm->bootstrapLoader, jarFile);
-
-  if (bytes == NULL) {
+  if (access(jarFile, R_OK) != 0) {
     printf("Unable to access jarfile %s\n", jarFile);
     return;
   }
 
   vmkit::BumpPtrAllocator allocator;
   ZipArchive* archive = new(allocator, "TempZipArchive")
-      ZipArchive(bytes, allocator);
+      ZipArchive(jarFile, allocator);
   if (archive->getOfscd() != -1) {
     ZipFile* file = archive->getFile(PATH_MANIFEST);
     if (file != NULL) {
-      res = new (allocator, file->ucsize) ClassBytes(file->ucsize);
+      // Null-terminate the manifest, it is searched as a string.
+      res = new (allocator, file->ucsize + 1) ClassBytes(file->ucsize);
+      res->elements[file->ucsize] = 0;
       int ok = archive->readFile(res, file);
       if (ok) {
         char* mainClass = findInformation(vm, res, MAIN_CLASS,
@@ -903,6 +921,7 @@ void ClArgumentsInfo::extractClassFromJar(Jnjvm* vm, int argc, char** argv,
   } else {
     printf("Can't find archive %s\n", jarFile);
   }
+  archive->~ZipArchive();
 }
 
 void ClArgumentsInfo::nyi() {
@@ -1032,12 +1051,20 @@ void ClArgumentsInfo::readArgs(Jnjvm* vm) {
       nyi();
     } else if (!(strcmp(cur, "-noclassgc"))) {
       nyi();
-    } else if (!(strcmp(cur, "-ms"))) {
-      nyi();
-    } else if (!(strcmp(cur, "-mx"))) {
-      nyi();
-    } else if (!(strcmp(cur, "-ss"))) {
-      nyi();
+    } else if (!(strncmp(cur, "-ms", 3)) || !(strncmp(cur, "-Xms", 4)) ||
+               !(strncmp(cur, "-mx", 3)) || !(strncmp(cur, "-Xmx", 4))) {
+      // Heap sizes are handled by vmkit::Collector::initialise.
+    } else if (!(strncmp(cur, "-ss", 3)) || !(strncmp(cur, "-Xss", 4))) {
+      const char* value = cur + (cur[1] == 'X' ? 4 : 3);
+      size_t size = vmkit::System::ParseMemorySize(value);
+      if (size == 0) {
+        printInformation();
+      } else if (size > vmkit::Thread::MaxStackSize) {
+        fprintf(stderr, "Invalid thread stack size: %s, the maximum is %luK\n",
+                cur, (unsigned long)(vmkit::Thread::MaxStackSize / 1024));
+      } else {
+        vmkit::Thread::DefaultStackSize = size;
+      }
     } else if (!(strcmp(cur, "-verbose"))) {
       nyi();
     } else if (!(strcmp(cur, "-verbose:class"))) {
@@ -1387,6 +1414,10 @@ void Jnjvm::startCollection() {
   referenceThread->PhantomReferencesQueue.acquire();
 }
 
+void Jnjvm::mutatorsStopped() {
+  lockSystem.deflateLocks();
+}
+
 void Jnjvm::endCollection() {
   finalizerThread->FinalizationQueueLock.release();
   referenceThread->ToEnqueueLock.release();
@@ -1399,6 +1430,7 @@ void Jnjvm::endCollection() {
   
 void Jnjvm::scanWeakReferencesQueue(word_t closure) {
   referenceThread->WeakReferencesQueue.scan(referenceThread, closure);
+  internedStrings.scan(closure);
 }
   
 void Jnjvm::scanSoftReferencesQueue(word_t closure) {
@@ -1508,6 +1540,37 @@ const char* Jnjvm::getObjectTypeName(gc* object) {
   }
 }
 
+bool Jnjvm::isBiasable(gc* object) {
+  JavaObject* src = 0;
+  llvm_gcroot(object, 0);
+  llvm_gcroot(src, 0);
+  src = (JavaObject*)object;
+  if (VMClassLoader::isVMClassLoader(src) ||
+      VMStaticInstance::isVMStaticInstance(src)) {
+    return true;
+  }
+  return !isUnbiasable(JavaObject::getClass(src)->access);
+}
+
+void Jnjvm::biasRevoked(gc* object) {
+  JavaObject* src = 0;
+  llvm_gcroot(object, 0);
+  llvm_gcroot(src, 0);
+  src = (JavaObject*)object;
+  if (VMClassLoader::isVMClassLoader(src) ||
+      VMStaticInstance::isVMStaticInstance(src)) {
+    return;
+  }
+  CommonClass* cl = JavaObject::getClass(src);
+  if (!cl->isClass()) return;
+  // Objects allocated afterwards are not biased on their first lock. Those
+  // already biased are revoked on their next lock by another thread.
+  uint32 count = __sync_add_and_fetch(&(cl->asClass()->biasRevocations), 1);
+  if (count == BiasRevocationThreshold) {
+    __sync_fetch_and_or(&(cl->access), JNJVM_UNBIASABLE);
+  }
+}
+
 // Helper function to run J3 without JIT.
 extern "C" int StartJnjvmWithoutJIT(int argc, char** argv, char* mainClass) {
   vmkit::Collector::initialise(argc, argv);
@@ -1548,6 +1611,13 @@ void Jnjvm::printMethod(vmkit::FrameInfo* FI, word_t ip, word_t addr) {
   fprintf(stderr, "\n");
 }
 
+void Jnjvm::getMethodName(void* metadata, char* buffer, size_t size) {
+  JavaMethod* meth = (JavaMethod*)metadata;
+  snprintf(buffer, size, "%s.%s",
+           UTF8Buffer(meth->classDef->name).cString(),
+           UTF8Buffer(meth->name).cString());
+}
+
 void Jnjvm::printBacktrace()
 {
 	std::cerr << "Back trace:" << std::endl;
@@ -127,6 +127,7 @@ private:
   JavaReferenceThread* referenceThread;
 
   virtual void startCollection();
+  virtual void mutatorsStopped();
   virtual void endCollection();
   virtual void scanWeakReferencesQueue(word_t closure);
   virtual void scanSoftReferencesQueue(word_t closure);
@@ -142,10 +143,13 @@ private:
   virtual const char* getObjectTypeName(gc* obj);
   virtual bool isCorruptedType(gc* header);
   virtual void printMethod(vmkit::FrameInfo* FI, word_t ip, word_t addr);
+  virtual void getMethodName(void* metadata, char* buffer, size_t size);
   virtual void invokeEnqueueReference(gc* res);
   virtual void clearObjectReferent(gc* ref);
   virtual gc** getObjectReferentPtr(gc* _obj);
   virtual void setObjectReferent(gc* _obj, gc* val);
+  virtual bool isBiasable(gc* obj);
+  virtual void biasRevoked(gc* obj);
 
   /// CreateError - Creates a Java object of the specified exception class
   /// and calling its <init> function.
@@ -206,6 +210,11 @@ public:
   /// Magic - The magic number at the beginning of each .class file. 0xcafebabe.
   ///
   static const unsigned int Magic;
+
+  /// BiasRevocationThreshold - The number of bias revocations on instances
+  /// of a class after which their locks are no longer biased.
+  ///
+  static const uint32 BiasRevocationThreshold;
  
   /// bootstraLoader - Bootstrap loader for base classes of this virtual
   /// machine.
@@ -252,6 +261,11 @@ public:
   /// globalRefsLock - Lock for adding a new global reference.
   ///
   vmkit::LockNormal globalRefsLock;
+
+  /// internedStrings - The strings interned by class loading, the compiler
+  /// and String.intern.
+  ///
+  StringMap internedStrings;
   
   /// appClassLoader - The bootstrap class loader.
   ///
@@ -304,9 +318,14 @@ public:
   ///
   JavaString* asciizToStr(const char* asciiz);
 
-  /// UTF8ToStr - Constructs a java/lang/String object from the given UTF8.
+  /// constructString - Constructs an interned java/lang/String object from
+  /// the given characters.
   ///
   JavaString* constructString(const ArrayUInt16* array);
+
+  /// internString - Returns the interned string equal to the given string.
+  ///
+  JavaString* internString(JavaString* str);
   
   /// UTF8ToStr - Constructs a java/lang/String object from the given internal
   /// UTF8, thus duplicating the UTF8.
@@ -30,6 +30,7 @@
 #include "vmkit/Allocator.h"
 
 #include "Classpath.h"
+#include "ClasspathIndex.h"
 #include "ClasspathReflect.h"
 #include "JavaClass.h"
 #include "j3/JavaCompiler.h"
@@ -70,6 +71,7 @@ JnjvmBootstrapLoader::JnjvmBootstrapLoader(vmkit::BumpPtrAllocator& Alloc,
    
   upcalls = new(allocator, "Classpath") Classpath();
   bootstrapLoader = this;
+  classpathIndex = new(allocator, "ClasspathIndex") ClasspathIndex(allocator);
    
   // Try to find if we have a pre-compiled rt.jar
   bool bootLoaded = false;
@@ -175,6 +177,8 @@ JnjvmBootstrapLoader::JnjvmBootstrapLoader(vmkit::BumpPtrAllocator& Alloc,
   VMFloatName = asciizConstructUTF8("java/lang/VMFloat");
   VMDoubleName = asciizConstructUTF8("java/lang/VMDouble");
   stackWalkerName = asciizConstructUTF8("gnu/classpath/VMStackWalker");
+  unsafeName = asciizConstructUTF8("sun/misc/Unsafe");
+  systemName = asciizConstructUTF8("java/lang/System");
   NoClassDefFoundError = asciizConstructUTF8("java/lang/NoClassDefFoundError");
 
 #define DEF_UTF8(var) \
@@ -208,6 +212,25 @@ JnjvmBootstrapLoader::JnjvmBootstrapLoader(vmkit::BumpPtrAllocator& Alloc,
   DEF_UTF8(doubleToRawLongBits);
   DEF_UTF8(intBitsToFloat);
   DEF_UTF8(longBitsToDouble);
+  DEF_UTF8(arraycopy);
+  DEF_UTF8(compareAndSwapInt);
+  DEF_UTF8(compareAndSwapLong);
+  DEF_UTF8(compareAndSwapObject);
+  DEF_UTF8(getInt);
+  DEF_UTF8(getLong);
+  DEF_UTF8(getObject);
+  DEF_UTF8(putInt);
+  DEF_UTF8(putLong);
+  DEF_UTF8(putObject);
+  DEF_UTF8(getIntVolatile);
+  DEF_UTF8(getLongVolatile);
+  DEF_UTF8(getObjectVolatile);
+  DEF_UTF8(putIntVolatile);
+  DEF_UTF8(putLongVolatile);
+  DEF_UTF8(putObjectVolatile);
+  DEF_UTF8(putOrderedInt);
+  DEF_UTF8(putOrderedLong);
+  DEF_UTF8(putOrderedObject);
 
 #undef DEF_UTF8 
 }
@@ -257,37 +280,18 @@ ClassBytes* JnjvmBootstrapLoader::openName(const UTF8* utf8) {
       UTF8Buffer(utf8).toCompileName("_bytes")->cString()));
   if (res != NULL) return res;
 
-  vmkit::ThreadAllocator threadAllocator;
-
-  char* asciiz = (char*)threadAllocator.Allocate(utf8->size + 1);
-  for (sint32 i = 0; i < utf8->size; ++i) 
-    asciiz[i] = utf8->elements[i];
-  asciiz[utf8->size] = 0;
-  
-  uint32 alen = utf8->size;
-  
-  for (std::vector<const char*>::iterator i = bootClasspath.begin(),
-       e = bootClasspath.end(); i != e; ++i) {
-    const char* str = *i;
-    unsigned int strLen = strlen(str);
-    char* buf = (char*)threadAllocator.Allocate(strLen + alen + 7);
-
-    sprintf(buf, "%s%s.class", str, asciiz);
-    res = Reader::openFile(this, buf);
-    if (res != NULL) return res;
-  }
+  ClasspathEntry* entry = classpathIndex->lookup(utf8);
+  if (entry == NULL) return NULL;
 
-  for (std::vector<ZipArchive*>::iterator i = bootArchives.begin(),
-       e = bootArchives.end(); i != e; ++i) {
-    
-    ZipArchive* archive = *i;
-    char* buf = (char*)threadAllocator.Allocate(alen + 7);
-    sprintf(buf, "%s.class", asciiz);
-    res = Reader::openZip(this, archive, buf);
-    if (res != NULL) return res;
+  if (entry->archive != NULL) {
+    return Reader::openZip(this, entry->archive, entry->file);
   }
 
-  return NULL;
+  vmkit::ThreadAllocator threadAllocator;
+  char* buf = (char*)threadAllocator.Allocate(
+      strlen(entry->directory) + strlen(entry->name) + 1);
+  sprintf(buf, "%s%s", entry->directory, entry->name);
+  return Reader::openFile(this, buf);
 }
 
 
@@ -946,8 +950,11 @@ JavaString** JnjvmBootstrapLoader::UTF8ToStr(const UTF8* val) {
   return strings->addString(this, res);
 }
 
+// Rank of the first archive of the boot class path in the class path index,
+// so that classes in directories take precedence.
+static const uint32 ArchiveRank = 0x10000;
+
 void JnjvmBootstrapLoader::analyseClasspathEnv(const char* str) {
-  ClassBytes* bytes = NULL;
   vmkit::ThreadAllocator threadAllocator;
   if (str != 0) {
     unsigned int len = strlen(str);
@@ -974,15 +981,19 @@ void JnjvmBootstrapLoader::analyseClasspathEnv(const char* str) {
             memcpy(temp, rp, len);
             temp[len] = Jnjvm::dirSeparator[0];
             temp[len + 1] = 0;
+            // Directories are searched before archives.
+            classpathIndex->addDirectory(temp, bootClasspath.size());
             bootClasspath.push_back(temp);
           } else {
-            bytes = Reader::openFile(this, rp);
-            if (bytes) {
-              ZipArchive *archive = new(allocator, "ZipArchive")
-                ZipArchive(bytes, allocator);
-              if (archive) {
-                bootArchives.push_back(archive);
-              }
+            ZipArchive *archive = new(allocator, "ZipArchive")
+              ZipArchive(rp, allocator);
+            if (archive->getOfscd() != -1) {
+              classpathIndex->addArchive(archive,
+                  ArchiveRank + bootArchives.size());
+              bootArchives.push_back(archive);
+            } else {
+              archive->~ZipArchive();
+              allocator.Deallocate(archive);
             }
           }
         } 
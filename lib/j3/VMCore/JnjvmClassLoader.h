@@ -32,6 +32,7 @@ class UserClass;
 class UserClassArray;
 class ClassBytes;
 class ClassMap;
+class ClasspathIndex;
 class Classpath;
 class UserCommonClass;
 class JavaCompiler;
@@ -370,6 +371,10 @@ private:
   /// bootArchives - List of .zip or .jar files that contain base classes.
   ///
   std::vector<ZipArchive*> bootArchives;
+
+  /// classpathIndex - Index of the classes of bootClasspath and bootArchives.
+  ///
+  ClasspathIndex* classpathIndex;
   
   /// openName - Opens a file of the given name and returns it as an array
   /// of byte.
@@ -422,6 +427,8 @@ public:
   const UTF8* VMFloatName;
   const UTF8* VMDoubleName;
   const UTF8* stackWalkerName;
+  const UTF8* unsafeName;
+  const UTF8* systemName;
   const UTF8* abs;
   const UTF8* sqrt;
   const UTF8* sin;
@@ -450,6 +457,25 @@ public:
   const UTF8* doubleToRawLongBits;
   const UTF8* intBitsToFloat;
   const UTF8* longBitsToDouble;
+  const UTF8* arraycopy;
+  const UTF8* compareAndSwapInt;
+  const UTF8* compareAndSwapLong;
+  const UTF8* compareAndSwapObject;
+  const UTF8* getInt;
+  const UTF8* getLong;
+  const UTF8* getObject;
+  const UTF8* putInt;
+  const UTF8* putLong;
+  const UTF8* putObject;
+  const UTF8* getIntVolatile;
+  const UTF8* getLongVolatile;
+  const UTF8* getObjectVolatile;
+  const UTF8* putIntVolatile;
+  const UTF8* putLongVolatile;
+  const UTF8* putObjectVolatile;
+  const UTF8* putOrderedInt;
+  const UTF8* putOrderedLong;
+  const UTF8* putOrderedObject;
 
   /// primitiveMap - Map of primitive classes, hashed by id.
   std::map<const char, UserClassPrimitive*> primitiveMap;
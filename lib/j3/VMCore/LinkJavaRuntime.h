@@ -20,6 +20,7 @@ namespace j3 {
   class UserConstantPool;
   class JavaVirtualTable;
   class JavaMethod;
+  class InlineCache;
   class Jnjvm;
 }
 
@@ -56,6 +57,10 @@ extern "C" JavaObject* j3IndexOutOfBoundsException(JavaObject* obj,
                                                       sint32 index);
 extern "C" JavaObject* j3ArrayStoreException(JavaVirtualTable* VT);
 extern "C" void j3ThrowExceptionFromJIT();
+extern "C" void j3PromoteMethod(JavaMethod* meth);
+extern "C" void j3InlineCacheMiss(JavaObject* obj, JavaMethod* meth,
+                                  InlineCache* cache);
+extern "C" void* j3StaticFieldBase(JavaObject* base);
 extern "C" void j3PrintMethodStart(JavaMethod* meth);
 extern "C" void j3PrintMethodEnd(JavaMethod* meth);
 extern "C" void j3PrintExecution(uint32 opcode, uint32 index,
@@ -94,6 +99,9 @@ namespace force_linker {
       (void) j3IndexOutOfBoundsException(0, 0);
       (void) j3ArrayStoreException(0);
       (void) j3ThrowExceptionFromJIT();
+      (void) j3PromoteMethod(0);
+      (void) j3InlineCacheMiss(0, 0, 0);
+      (void) j3StaticFieldBase(0);
       (void) j3PrintMethodStart(0);
       (void) j3PrintMethodEnd(0);
       (void) j3PrintExecution(0, 0, 0);
@@ -30,6 +30,7 @@
 
 namespace j3 {
 
+class JavaString;
 class Signdef;
 class Typedef;
 class UserCommonClass;
@@ -58,6 +59,83 @@ public:
   typedef vmkit::VmkitDenseMap<const vmkit::UTF8*, Signdef*>::iterator iterator;
 };
 
+/// StringMap - The interned strings of a JVM, keyed by their characters.
+/// The map is split in stripes, each with its own lock, so that threads
+/// interning different strings rarely contend. Strings are held weakly: the
+/// collector removes the unreachable ones and updates the moved ones by
+/// calling scan.
+///
+class StringMap : public vmkit::PermanentObject {
+  /// NbStripes - The number of stripes, a power of two.
+  ///
+  static const uint32 NbStripes = 32;
+
+  struct Entry {
+    uint32 hash;
+    JavaString* string;
+  };
+
+  /// Stripe - Open addressed hash table with linear probing.
+  ///
+  struct Stripe {
+    vmkit::LockNormal lock;
+    Entry* table;
+    uint32 capacity;
+    uint32 size;
+  };
+
+  Stripe stripes[NbStripes];
+
+  /// hash - The hash of the characters, as computed by String.hashCode.
+  ///
+  static uint32 hash(const uint16* chars, sint32 length);
+
+  /// mix - Scramble the hash, whose high bits are poor for short strings.
+  /// The high bits of the result select the stripe, the low bits the slot.
+  ///
+  static uint32 mix(uint32 hash) { return hash * 0x9E3779B1U; }
+
+  Stripe& getStripe(uint32 hash) {
+    return stripes[mix(hash) >> 27];
+  }
+
+  JavaString* lookup(Stripe& stripe, uint32 hash, const uint16* chars,
+                     sint32 length);
+  void insert(Stripe& stripe, uint32 hash, JavaString* str);
+  void grow(Stripe& stripe);
+
+public:
+  StringMap() {
+    for (uint32 i = 0; i < NbStripes; ++i) {
+      stripes[i].table = NULL;
+      stripes[i].capacity = 0;
+      stripes[i].size = 0;
+    }
+  }
+
+  ~StringMap() {
+    for (uint32 i = 0; i < NbStripes; ++i) {
+      delete[] stripes[i].table;
+    }
+  }
+
+  /// lookup - Return the interned string with the characters of str, or
+  /// null.
+  ///
+  JavaString* lookup(JavaString* str);
+
+  /// intern - Return the interned string with the characters of str. If
+  /// there is none, str becomes the interned string.
+  ///
+  JavaString* intern(JavaString* str);
+
+  /// scan - Remove the strings the collector did not reach, and update the
+  /// strings it moved. Called by the collector when processing weak
+  /// references.
+  ///
+  void scan(word_t closure);
+};
+
 } // end namespace j3
 
 #endif
@@ -41,17 +41,19 @@ ClassBytes* Reader::openFile(JnjvmClassLoader* loader, const char* path) {
 
 ClassBytes* Reader::openZip(JnjvmClassLoader* loader, ZipArchive* archive,
                             const char* filename) {
-  ClassBytes* res = 0;
   ZipFile* file = archive->getFile(filename);
   if (file != 0) {
-    res = new (loader->allocator, file->ucsize) ClassBytes(file->ucsize);
-    if (archive->readFile(res, file) != 0) {
-      return res;
-    }
+    return openZip(loader, archive, file);
   }
   return NULL;
 }
 
+ClassBytes* Reader::openZip(JnjvmClassLoader* loader, ZipArchive* archive,
+                            ZipFile* file) {
+  // The bytes are kept by the class, so they are never released.
+  return archive->getContents(file);
+}
+
 void Reader::seek(uint32 pos, int from) {
   uint32 n = 0;
   uint32 start = min;
@@ -20,21 +20,35 @@ namespace j3 {
 class JnjvmBootstrapLoader;
 class JnjvmClassLoader;
 class ZipArchive;
+struct ZipFile;
 
 
+/// ClassBytes - The contents of a class file or of an archive. The bytes
+/// either follow the header, or live elsewhere, e.g. in a mapped archive.
+///
 class ClassBytes {
  public:
   ClassBytes(int l) {
     size = l;
+    elements = (uint8_t*)(this + 1);
+  }
+
+  ClassBytes(int l, uint8_t* e) {
+    size = l;
+    elements = e;
   }
 
   void* operator new(size_t sz, vmkit::BumpPtrAllocator& allocator, int n) {
-    return allocator.Allocate(sizeof(uint32_t) + n * sizeof(uint8_t),
+    return allocator.Allocate(sizeof(ClassBytes) + n * sizeof(uint8_t),
                               "Class bytes");
   }
 
+  void* operator new(size_t sz, void* buffer) {
+    return buffer;
+  }
+
   uint32_t size;
-  uint8_t elements[1];
+  uint8_t* elements;
 };
 
 class Reader {
@@ -74,6 +88,8 @@ public:
   static ClassBytes* openFile(JnjvmClassLoader* loader, const char* path);
   static ClassBytes* openZip(JnjvmClassLoader* loader, ZipArchive* archive,
                              const char* filename);
+  static ClassBytes* openZip(JnjvmClassLoader* loader, ZipArchive* archive,
+                             ZipFile* file);
   
   uint8 readU1() {
     ++cursor;
@@ -71,7 +71,9 @@ VirtualTable VMStaticInstance::VT((word_t)VMStaticInstance::staticDestructor,
 // Trace methods for Java objects. There are four types of objects:
 // (1) java.lang.Object and primitive arrays: no need to trace anything.
 // (2) Object whose class is not an array: needs to trace the classloader, and
-//     all the virtual fields.
+//     all the virtual fields. The offsets of the reference fields are
+//     computed once per class, see Class::computeReferenceOffsets. Objects
+//     without reference fields only trace the classloader.
 // (3) Object whose class is an array of objects: needs to trace the class
 //     loader and all elements in the array.
 // (4) Objects that extend java.lang.ref.Reference: must trace the class loader
@@ -83,23 +85,38 @@ extern "C" void JavaObjectTracer(JavaObject* obj, word_t closure) {
   llvm_gcroot(obj, 0);
 }
 
+/// Trace the class loader of an object. Objects of classes loaded by the
+/// bootstrap loader have no class loader object to trace.
+static inline void traceClassLoader(JavaObject* obj, CommonClass* cl,
+                                    word_t closure) {
+  llvm_gcroot(obj, 0);
+  JavaObject** loader = cl->classLoader->getJavaClassLoaderPtr();
+  if (*loader != NULL) {
+    vmkit::Collector::markAndTraceRoot(obj, loader, closure);
+  }
+}
+
+/// Method for scanning regular objects without reference fields.
+extern "C" void NoReferenceObjectTracer(JavaObject* obj, word_t closure) {
+  llvm_gcroot(obj, 0);
+  CommonClass* cl = JavaObject::getClass(obj);
+  assert(cl && "No class");
+  traceClassLoader(obj, cl, closure);
+}
+
 /// Method for scanning regular objects.
 extern "C" void RegularObjectTracer(JavaObject* obj, word_t closure) {
   llvm_gcroot(obj, 0);
   Class* cl = JavaObject::getClass(obj)->asClass();
   assert(cl && "Not a class in regular tracer");
-  vmkit::Collector::markAndTraceRoot(obj,
-      cl->classLoader->getJavaClassLoaderPtr(), closure);
+  assert((cl->referenceOffsets || !cl->nbReferenceOffsets) &&
+         "Reference offsets not computed");
+  traceClassLoader(obj, cl, closure);
 
-  while (cl->super != 0) {
-    for (uint32 i = 0; i < cl->nbVirtualFields; ++i) {
-      JavaField& field = cl->virtualFields[i];
-      if (field.isReference()) {
-        JavaObject** ptr = field.getInstanceObjectFieldPtr(obj);
-        vmkit::Collector::markAndTrace(obj, ptr, closure);
-      }
-    }
-    cl = cl->super;
+  uint32* offsets = cl->referenceOffsets;
+  for (uint32 i = 0; i < cl->nbReferenceOffsets; ++i) {
+    JavaObject** ptr = (JavaObject**)((word_t)obj + offsets[i]);
+    vmkit::Collector::markAndTrace(obj, ptr, closure);
   }
 }
 
@@ -130,23 +147,18 @@ extern "C" void ReferenceObjectTracer(
   llvm_gcroot(obj, 0);
   Class* cl = JavaObject::getClass(obj)->asClass();
   assert(cl && "Not a class in reference tracer");
-  vmkit::Collector::markAndTraceRoot(obj,
-      cl->classLoader->getJavaClassLoaderPtr(), closure);
+  traceClassLoader(obj, cl, closure);
 
   bool found = false;
-  while (cl->super != 0) {
-    for (uint32 i = 0; i < cl->nbVirtualFields; ++i) {
-      JavaField& field = cl->virtualFields[i];
-      if (field.isReference()) {
-        JavaObject** ptr = field.getInstanceObjectFieldPtr(obj);
-        if (ptr != JavaObjectReference::getReferentPtr(obj)) {
-          vmkit::Collector::markAndTrace(obj, ptr, closure);
-        } else {
-          found = true;
-        }
-      }
+  uint32* offsets = cl->referenceOffsets;
+  JavaObject** referent = JavaObjectReference::getReferentPtr(obj);
+  for (uint32 i = 0; i < cl->nbReferenceOffsets; ++i) {
+    JavaObject** ptr = (JavaObject**)((word_t)obj + offsets[i]);
+    if (ptr != referent) {
+      vmkit::Collector::markAndTrace(obj, ptr, closure);
+    } else {
+      found = true;
     }
-    cl = cl->super;
   }
   assert(found && "No referent in a reference");
 }
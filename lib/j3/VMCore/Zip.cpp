@@ -7,6 +7,12 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <cassert>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <zlib.h>
 
 #include "vmkit/Allocator.h"
@@ -17,16 +23,102 @@
 
 using namespace j3;
 
-ZipArchive::ZipArchive(ClassBytes* bytes, vmkit::BumpPtrAllocator& A) : allocator(A) {
+uint32 ZipArchive::MaxCacheSize = 4 * 1024 * 1024;
+
+void ZipArchive::initialise(ClassBytes* bytes) {
   this->bytes = bytes;
+  filetable = NULL;
+  capacity = 0;
+  nbFiles = 0;
+  cacheHead = NULL;
+  cacheTail = NULL;
+  cacheSize = 0;
+  ofscd = -1;
+  if (bytes == NULL) return;
   findOfscd();
   if (ofscd > -1) addFiles();
 }
 
+ZipArchive::ZipArchive(ClassBytes* bytes, vmkit::BumpPtrAllocator& A) : allocator(A) {
+  mapping = NULL;
+  mappingSize = 0;
+  initialise(bytes);
+}
+
+ZipArchive::ZipArchive(const char* path, vmkit::BumpPtrAllocator& A) : allocator(A) {
+  mapping = NULL;
+  mappingSize = 0;
+
+  int fd = open(path, O_RDONLY);
+  if (fd >= 0) {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && st.st_size <= 0x7FFFFFFF) {
+      void* res = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (res != MAP_FAILED) {
+        mapping = res;
+        mappingSize = st.st_size;
+      }
+    }
+    close(fd);
+  }
+
+  if (mapping != NULL) {
+    initialise(new (allocator, 0) ClassBytes(mappingSize, (uint8*)mapping));
+  } else {
+    initialise(NULL);
+  }
+}
+
+void ZipArchive::grow() {
+  uint32 newCapacity = capacity ? capacity * 2 : 256;
+  ZipFile** newTable = new ZipFile*[newCapacity];
+  memset(newTable, 0, newCapacity * sizeof(ZipFile*));
+  for (uint32 i = 0; i < capacity; ++i) {
+    ZipFile* file = filetable[i];
+    if (file == NULL) continue;
+    uint32 index = file->hash & (newCapacity - 1);
+    while (newTable[index] != NULL) {
+      index = (index + 1) & (newCapacity - 1);
+    }
+    newTable[index] = file;
+  }
+  delete[] filetable;
+  filetable = newTable;
+  capacity = newCapacity;
+}
+
+void ZipArchive::insert(ZipFile* file) {
+  // Keep the load factor under 1/2.
+  if (2 * (nbFiles + 1) > capacity) grow();
+  uint32 index = file->hash & (capacity - 1);
+  while (filetable[index] != NULL) {
+    ZipFile* cur = filetable[index];
+    // Like the central directory readers, keep the first entry of a name.
+    if (cur->hash == file->hash &&
+        cur->filenameLength == file->filenameLength &&
+        !memcmp(cur->filename, file->filename, file->filenameLength)) {
+      return;
+    }
+    index = (index + 1) & (capacity - 1);
+  }
+  filetable[index] = file;
+  ++nbFiles;
+}
+
 ZipFile* ZipArchive::getFile(const char* filename) {
-  table_iterator End = filetable.end();
-  table_iterator I = filetable.find(filename);
-  return I != End ? I->second : 0;
+  if (nbFiles == 0) return NULL;
+  uint32 length = strlen(filename);
+  uint32 hash = hashFileName(filename, length);
+  uint32 index = hash & (capacity - 1);
+  while (filetable[index] != NULL) {
+    ZipFile* cur = filetable[index];
+    if (cur->hash == hash && cur->filenameLength == length &&
+        !memcmp(cur->filename, filename, length)) {
+      return cur;
+    }
+    index = (index + 1) & (capacity - 1);
+  }
+  return NULL;
 }
 
 
@@ -152,8 +244,10 @@ void ZipArchive::addFiles() {
            ptr->filenameLength);
     ptr->filename[ptr->filenameLength] = 0;
 
-    if (ptr->filename[ptr->filenameLength - 1] != PATH_SEPARATOR) {
-      filetable.insert(std::make_pair(ptr->filename, ptr));
+    if (ptr->filenameLength > 0 &&
+        ptr->filename[ptr->filenameLength - 1] != PATH_SEPARATOR) {
+      ptr->hash = hashFileName(ptr->filename, ptr->filenameLength);
+      insert(ptr);
     }
 
     temp = temp + ptr->filenameLength + ptr->extraFieldLength + 
@@ -239,3 +333,104 @@ sint32 ZipArchive::readFile(ClassBytes* array, const ZipFile* file) {
   }
   return 0;
 }
+
+ZipArchive::~ZipArchive() {
+  for (uint32 i = 0; i < capacity; ++i) {
+    ZipFile* file = filetable[i];
+    if (file == NULL) continue;
+    if (file->contents != NULL && file->compressionMethod != ZIP_STORE) {
+      free(file->contents);
+    }
+    allocator.Deallocate((void*)file->filename);
+    file->~ZipFile();
+    allocator.Deallocate((void*)file);
+  }
+  delete[] filetable;
+  if (mapping != NULL) munmap(mapping, mappingSize);
+}
+
+/// getDataOffset - Return the offset of the data of the file in the archive,
+/// or -1 if the local header of the file is invalid.
+///
+static sint32 getDataOffset(ClassBytes* bytes, const ZipFile* file) {
+  if (file->rolh < 0 ||
+      (uint32)file->rolh + 4 + LOCAL_FILE_HEADER_SIZE > bytes->size ||
+      memcmp(bytes->elements + file->rolh, HDR_LOCAL, 4)) {
+    return -1;
+  }
+  Reader reader(bytes);
+  reader.cursor = file->rolh + 4 + L_FILENAME_LENGTH;
+  uint32 filenameLength = readEndianDep2(reader);
+  uint32 extraFieldLength = readEndianDep2(reader);
+  uint32 offset = file->rolh + 4 + LOCAL_FILE_HEADER_SIZE + filenameLength +
+    extraFieldLength;
+  if (file->ucsize < 0 || offset + file->ucsize > bytes->size) return -1;
+  return offset;
+}
+
+ClassBytes* ZipArchive::getContents(ZipFile* file) {
+  ClassBytes* res = NULL;
+  cacheLock.lock();
+  if (file->contents != NULL) {
+    res = file->contents;
+    if (file->compressionMethod != ZIP_STORE) {
+      if (file->pins == 0) unlinkCached(file);
+      ++file->pins;
+    }
+  } else if (file->compressionMethod == ZIP_STORE) {
+    // Stored files are used in place: their pages are shared with the page
+    // cache and reclaimed by the system when needed.
+    sint32 offset = getDataOffset(bytes, file);
+    if (offset >= 0) {
+      res = new (allocator, 0) ClassBytes(file->ucsize, bytes->elements + offset);
+      file->contents = res;
+    }
+  } else {
+    void* buffer = malloc(sizeof(ClassBytes) + file->ucsize);
+    res = new (buffer) ClassBytes(file->ucsize);
+    if (readFile(res, file)) {
+      file->contents = res;
+      file->pins = 1;
+    } else {
+      free(buffer);
+      res = NULL;
+    }
+  }
+  cacheLock.unlock();
+  return res;
+}
+
+void ZipArchive::releaseContents(ZipFile* file) {
+  if (file->compressionMethod == ZIP_STORE) return;
+  cacheLock.lock();
+  assert(file->pins > 0 && "Releasing contents that are not pinned");
+  if (--file->pins == 0) {
+    file->prevCached = cacheTail;
+    file->nextCached = NULL;
+    if (cacheTail != NULL) cacheTail->nextCached = file;
+    else cacheHead = file;
+    cacheTail = file;
+    cacheSize += file->ucsize;
+    evict();
+  }
+  cacheLock.unlock();
+}
+
+void ZipArchive::unlinkCached(ZipFile* file) {
+  if (file->prevCached != NULL) file->prevCached->nextCached = file->nextCached;
+  else cacheHead = file->nextCached;
+  if (file->nextCached != NULL) file->nextCached->prevCached = file->prevCached;
+  else cacheTail = file->prevCached;
+  file->prevCached = NULL;
+  file->nextCached = NULL;
+  cacheSize -= file->ucsize;
+}
+
+void ZipArchive::evict() {
+  while (cacheSize > MaxCacheSize) {
+    ZipFile* file = cacheHead;
+    unlinkCached(file);
+    free(file->contents);
+    file->contents = NULL;
+  }
+}
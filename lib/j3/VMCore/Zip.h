@@ -10,15 +10,28 @@
 #ifndef JNJVM_ZIP_H
 #define JNJVM_ZIP_H
 
-#include <map>
-
 #include "vmkit/Allocator.h"
+#include "vmkit/Locks.h"
 
 namespace j3 {
 
-class classBytes;
+class ClassBytes;
 class JnjvmBootstrapLoader;
 
+/// hashFileName - The FNV-1a hash of the low byte of each character of a
+/// file name. Used to look up the files of archives and the classes of the
+/// class path, whether the name is made of chars or of UTF8 elements.
+///
+template <typename Char>
+uint32 hashFileName(const Char* name, uint32 length) {
+  uint32 hash = 2166136261U;
+  for (uint32 i = 0; i < length; ++i) {
+    hash ^= (uint8)name[i];
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
 struct ZipFile : public vmkit::PermanentObject {
   char* filename;
   int ucsize;
@@ -28,52 +41,149 @@ struct ZipFile : public vmkit::PermanentObject {
   uint32 fileCommentLength;
   int rolh;
   int compressionMethod;
+
+  /// hash - The hash of the file name.
+  ///
+  uint32 hash;
+
+  /// contents - The contents of the file, if they have been read. Stored
+  /// files point into the archive, deflated files to an inflated buffer.
+  ///
+  ClassBytes* contents;
+
+  /// pins - Number of users of the inflated buffer. A deflated file that is
+  /// not pinned may be evicted from the cache.
+  ///
+  uint32 pins;
+
+  /// prevCached, nextCached - The list of unpinned inflated files, the least
+  /// recently used first.
+  ///
+  ZipFile* prevCached;
+  ZipFile* nextCached;
 };
 
 
 
 class ZipArchive : public vmkit::PermanentObject {
-  
+
   vmkit::BumpPtrAllocator& allocator;
 
-  struct ltstr
-  {
-    bool operator()(const char* s1, const char* s2) const
-    {
-      return strcmp(s1, s2) < 0;
-    }
-  };
-  
   int ofscd;
 
+  /// filetable - Open addressed hash table of the files, with linear probing.
+  ///
+  ZipFile** filetable;
+  uint32 capacity;
+  uint32 nbFiles;
+
+  /// mapping, mappingSize - The memory mapping of the archive file, if the
+  /// archive was opened from a file.
+  ///
+  void* mapping;
+  size_t mappingSize;
+
+  /// cacheLock - Protects the contents of the files and the cache.
+  ///
+  vmkit::LockNormal cacheLock;
+
+  /// cacheHead, cacheTail - The list of unpinned inflated files.
+  ///
+  ZipFile* cacheHead;
+  ZipFile* cacheTail;
+
+  /// cacheSize - The size of the unpinned inflated files.
+  ///
+  uint32 cacheSize;
+
 public:
-  std::map<const char*, ZipFile*, ltstr> filetable;
-  typedef std::map<const char*, ZipFile*, ltstr>::iterator table_iterator;
   ClassBytes* bytes;
 
+  /// MaxCacheSize - The size of unpinned inflated files an archive keeps
+  /// around for later reads.
+  ///
+  static uint32 MaxCacheSize;
+
+  /// table_iterator - Iterator over the files of the archive.
+  ///
+  class table_iterator {
+    ZipFile** cur;
+    ZipFile** end;
+
+    void skipEmpty() {
+      while (cur != end && *cur == NULL) ++cur;
+    }
+
+  public:
+    table_iterator(ZipFile** c, ZipFile** e) : cur(c), end(e) {
+      skipEmpty();
+    }
+
+    ZipFile* operator*() const { return *cur; }
+    ZipFile* operator->() const { return *cur; }
+
+    table_iterator& operator++() {
+      ++cur;
+      skipEmpty();
+      return *this;
+    }
+
+    bool operator==(const table_iterator& other) const {
+      return cur == other.cur;
+    }
+
+    bool operator!=(const table_iterator& other) const {
+      return cur != other.cur;
+    }
+  };
+
 private:
-  
+
   void findOfscd();
   void addFiles();
-  
-  void remove();
+  void insert(ZipFile* file);
+  void grow();
+  void initialise(ClassBytes* bytes);
+
+  void unlinkCached(ZipFile* file);
+  void evict();
 
 public:
-  
-  ~ZipArchive() {
-    for (table_iterator I = filetable.begin(), E = filetable.end(); I != E; 
-         ++I) {
-      allocator.Deallocate((void*)I->first);
-      I->second->~ZipFile();
-      allocator.Deallocate((void*)I->second);
-    }
-  }
+
+  ~ZipArchive();
 
   int getOfscd() { return ofscd; }
+
+  /// ZipArchive - Create an archive from bytes in memory.
+  ///
   ZipArchive(ClassBytes* bytes, vmkit::BumpPtrAllocator& allocator);
+
+  /// ZipArchive - Map the archive file read-only. The archive is invalid,
+  /// i.e. getOfscd returns -1, if the file can not be mapped.
+  ///
+  ZipArchive(const char* path, vmkit::BumpPtrAllocator& allocator);
+
+  table_iterator begin() {
+    return table_iterator(filetable, filetable + capacity);
+  }
+
+  table_iterator end() {
+    return table_iterator(filetable + capacity, filetable + capacity);
+  }
+
   ZipFile* getFile(const char* filename);
   int readFile(ClassBytes* array, const ZipFile* file);
 
+  /// getContents - Return the contents of the file, or null if the file can
+  /// not be read. Stored files are not copied. Deflated files are pinned in
+  /// the cache until releaseContents is called.
+  ///
+  ClassBytes* getContents(ZipFile* file);
+
+  /// releaseContents - Release the contents returned by getContents. The
+  /// contents must not be used afterwards.
+  ///
+  void releaseContents(ZipFile* file);
 };
 
 } // end namespace j3
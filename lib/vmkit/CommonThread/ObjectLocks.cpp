@@ -25,6 +25,65 @@
 
 namespace vmkit {
 
+/// setBiasedCount - Change the count of a lock biased towards the current
+/// thread. The other bits of the header may be changed concurrently, e.g. by
+/// hashCode, so only the byte of the count is written.
+static void setBiasedCount(gc* object, word_t header) {
+  llvm_gcroot(object, 0);
+  ((volatile uint8_t*)&(object->header()))[ThinLock::BiasedCountByte] =
+    (uint8_t)(header >> ThinLock::ThinCountShift);
+}
+
+/// unbiasedHeader - The header of an object once the bias of its lock is
+/// revoked.
+static word_t unbiasedHeader(word_t header) {
+  word_t count = header & ThinLock::ThinCountMask;
+  word_t nonLockBits = (header & ThinLock::NonLockBitsMask & ~ThinLock::BiasedMask) |
+    ThinLock::UnbiasableMask;
+  if (count == 0) return nonLockBits;
+  // A thin lock held once has a count of zero.
+  return (header & System::GetThreadIDMask()) | (count - ThinLock::ThinCountAdd) |
+    nonLockBits;
+}
+
+void ThinLock::revokeBias(gc* object, LockSystem& table) {
+  llvm_gcroot(object, 0);
+  vmkit::Thread* self = vmkit::Thread::get();
+  word_t oldValue = object->header();
+  if (!(oldValue & BiasedMask)) return;
+
+  if ((oldValue & System::GetThreadIDMask()) == self->getThreadID()) {
+    // Other threads may only change the non-lock bits.
+    word_t yieldedValue = 0;
+    do {
+      oldValue = object->header();
+      yieldedValue = __sync_val_compare_and_swap(
+          &(object->header()), oldValue, unbiasedHeader(oldValue));
+    } while (yieldedValue != oldValue);
+    return;
+  }
+
+  // The thread the lock is biased towards changes the count without atomic
+  // operations: stop it, and all other threads, in the rendezvous of the
+  // collector. Threads do not reach a safe point while changing the count.
+  VirtualMachine* vm = self->MyVM;
+  while (true) {
+    vm->rendezvous.startRV();
+    if (vm->rendezvous.getInitiator() != NULL) {
+      vm->rendezvous.cancelRV();
+      vm->rendezvous.join();
+      if (!(object->header() & BiasedMask)) return;
+    } else {
+      vm->rendezvous.synchronize();
+      oldValue = object->header();
+      if (oldValue & BiasedMask) object->header() = unbiasedHeader(oldValue);
+      vm->rendezvous.finishRV();
+      if (oldValue & BiasedMask) vm->biasRevoked(object);
+      return;
+    }
+  }
+}
+
 void ThinLock::overflowThinLock(gc* object, LockSystem& table) {
   llvm_gcroot(object, 0);
   FatLock* obj = table.allocate(object);
@@ -42,33 +101,10 @@ void ThinLock::overflowThinLock(gc* object, LockSystem& table) {
   } while (((object->header()) & ~NonLockBitsMask) != ID);
   assert(obj->associatedObject == object);
 }
- 
-/// initialise - Initialise the value of the lock.
-///
-#if 0
-// Disable fat lock deflation code in ObjectLocks.cpp
-// Fixes occasional assertion failure when running on multi-core machine.
-void ThinLock::removeFatLock(FatLock* fatLock, LockSystem& table) {
-  gc* object = fatLock->associatedObject;
-  llvm_gcroot(object, 0);
-  word_t ID;
-  word_t oldValue = 0;
-  word_t newValue = 0;
-  word_t yieldedValue = 0;
-
-  ID = fatLock->getID();
-  do {
-    oldValue = object->header();
-    newValue = oldValue & NonLockBitsMask;
-    yieldedValue = __sync_val_compare_and_swap(&object->header(), oldValue, newValue);
-  } while (oldValue != yieldedValue);
-  assert((oldValue & NonLockBitsMask) != ID);
-  fatLock->associatedObject = NULL;
-}
-#endif
   
 FatLock* ThinLock::changeToFatlock(gc* object, LockSystem& table) {
   llvm_gcroot(object, 0);
+  revokeBias(object, table);
   if (!(object->header() & FatMask)) {
     FatLock* obj = table.allocate(object);
     uint32 count = (object->header() & ThinCountMask) >> ThinCountShift;
@@ -120,6 +156,17 @@ void ThinLock::acquire(gc* object, LockSystem& table) {
   word_t newValue = 0;
   word_t yieldedValue = 0;
 
+  oldValue = object->header();
+  if (oldValue & BiasedMask) {
+    if ((oldValue & System::GetThreadIDMask()) == id &&
+        (oldValue & ThinCountMask) != ThinCountMask) {
+      setBiasedCount(object, oldValue + ThinCountAdd);
+      assert(owner(object, table) && "Not owner after quitting acquire!");
+      return;
+    }
+    revokeBias(object, table);
+  }
+
   if ((object->header() & System::GetThreadIDMask()) == id) {
     assert(owner(object, table) && "Inconsistent lock");
     if ((object->header() & ThinCountMask) != ThinCountMask) {
@@ -136,13 +183,20 @@ void ThinLock::acquire(gc* object, LockSystem& table) {
     return;
   }
 
+  // The first thread to get a lock that has never been revoked takes the
+  // bias, unless the virtual machine stopped biasing the locks of this kind
+  // of object.
+  bool biasable = vmkit::Thread::get()->MyVM->isBiasable(object);
   do {
     oldValue = object->header() & NonLockBitsMask;
     newValue = oldValue | id;
+    if (biasable && !(oldValue & UnbiasableMask)) {
+      newValue |= BiasedMask | ThinCountAdd;
+    }
     yieldedValue = __sync_val_compare_and_swap(&(object->header()), oldValue, newValue);
   } while ((object->header() & ~NonLockBitsMask) == 0);
 
-  if (((object->header()) & ~NonLockBitsMask) == id) {
+  if (yieldedValue == oldValue) {
     assert(owner(object, table) && "Not owner after quitting acquire!");
     return;
   }
@@ -150,6 +204,10 @@ void ThinLock::acquire(gc* object, LockSystem& table) {
   // Simple counter to lively diagnose possible dead locks in this code.
   int counter = 0;  
   while (true) {
+    if (object->header() & BiasedMask) {
+      revokeBias(object, table);
+    }
+
     if (object->header() & FatMask) {
       FatLock* obj = table.getFatLockFromID(object->header());
       if (obj != NULL) {
@@ -165,9 +223,16 @@ void ThinLock::acquire(gc* object, LockSystem& table) {
     counter++;
     if (counter == 1000) printDebugMessage(object, table);
 
+    // Spin a little while the owner releases the thin lock, then yield. The
+    // lock is inflated as soon as it is released, so this only happens the
+    // first time the lock is contended.
+    uint32 spins = 0;
     while (object->header() & ~NonLockBitsMask) {
-      if (object->header() & FatMask) {
+      if (object->header() & (FatMask | BiasedMask)) {
         break;
+      } else if (spins < SpinLimit) {
+        ++spins;
+        vmkit::System::SpinPause();
       } else {
         vmkit::Thread::yield();
       }
@@ -208,6 +273,16 @@ void ThinLock::release(gc* object, LockSystem& table, vmkit::Thread* ownerThread
   word_t newValue = 0;
   word_t yieldedValue = 0;
 
+  oldValue = object->header();
+  if (oldValue & BiasedMask) {
+    if (ownerThread == vmkit::Thread::get()) {
+      assert((oldValue & ThinCountMask) && "Inconsistent lock");
+      setBiasedCount(object, oldValue - ThinCountAdd);
+      return;
+    }
+    revokeBias(object, table);
+  }
+
   if ((object->header() & ~NonLockBitsMask) == id) {
     do {
       oldValue = object->header();
@@ -241,6 +316,9 @@ bool ThinLock::owner(gc* object, LockSystem& table) {
   	bool res = false;
     uint64 id = vmkit::Thread::get()->getThreadID();
     res = ((object->header() & System::GetThreadIDMask()) == id);
+    if (res && (object->header() & BiasedMask)) {
+      res = (object->header() & ThinCountMask) != 0;
+    }
     if (res) return true;
   }
   return false;
@@ -252,6 +330,9 @@ vmkit::Thread* ThinLock::getOwner(gc* object, LockSystem& table)
   if (object->header() & FatMask) {
 	FatLock* obj = table.getFatLockFromID(object->header());
 	return (!obj) ? NULL : obj->getOwner();
+  } else if ((object->header() & BiasedMask) &&
+             !(object->header() & ThinCountMask)) {
+	return NULL;
   } else {
 	uint64_t threadID = object->header() & System::GetThreadIDMask();
 	return vmkit::Thread::getByID(threadID);
@@ -293,6 +374,7 @@ FatLock::FatLock(uint32_t i, gc* a) :
   waitingThreads = 0;
   lockingThreads = 0;
   nextFreeLock = NULL;
+  spinLimit = MinSpinLimit;
 }
 
 word_t FatLock::getID() {
@@ -303,15 +385,6 @@ void FatLock::release(gc* obj, LockSystem& table, vmkit::Thread* ownerThread) {
   llvm_gcroot(obj, 0);
   assert(associatedObject && "No associated object when releasing");
   assert(associatedObject == obj && "Mismatch object in lock");
-#if 0
-  // Disable fat lock deflation code in ObjectLocks.cpp
-  // Fixes occasional assertion failure when running on multi-core machine.
-  if (!waitingThreads && !lockingThreads &&
-      internalLock.recursionCount() == 1) {
-    vmkit::ThinLock::removeFatLock(this, table);
-    table.deallocate(this);
-  }
-#endif
   internalLock.unlock(ownerThread);
 }
 
@@ -320,15 +393,11 @@ void FatLock::release(gc* obj, LockSystem& table, vmkit::Thread* ownerThread) {
 bool FatLock::acquire(gc* obj, LockSystem& table) {
   llvm_gcroot(obj, 0);
     
-  spinLock.lock();
-  lockingThreads++;
-  spinLock.unlock();
+  __sync_fetch_and_add(&lockingThreads, 1);
     
-  internalLock.lock();
+  if (!spin()) internalLock.lock();
     
-  spinLock.lock();
-  lockingThreads--;
-  spinLock.unlock();
+  __sync_fetch_and_sub(&lockingThreads, 1);
 
   if (this->associatedObjectIsDead()) {
     internalLock.unlock();
@@ -351,6 +420,23 @@ bool FatLock::acquire(gc* obj, LockSystem& table) {
 }
 
 
+bool FatLock::spin() {
+  if (internalLock.selfOwner()) return false;
+
+  uint32_t limit = spinLimit;
+  for (uint32_t i = 0; i < limit; ++i) {
+    if (internalLock.getOwner() == NULL && !internalLock.tryLock()) {
+      if (limit < MaxSpinLimit) spinLimit = limit * 2;
+      return true;
+    }
+    vmkit::System::SpinPause();
+  }
+
+  if (limit > MinSpinLimit) spinLimit = limit / 2;
+  return false;
+}
+
+
 void LockSystem::deallocate(FatLock* lock) {
   lock->associatedObject = NULL;
   threadLock.lock();
@@ -361,6 +447,9 @@ void LockSystem::deallocate(FatLock* lock) {
   
 LockSystem::LockSystem(vmkit::BumpPtrAllocator& all) : allocator(all) {
   assert(ThinLock::ThinCountMask > 0);
+  assert(!(ThinLock::ThinCountShift & 7) &&
+         !((ThinLock::ThinCountMask >> ThinLock::ThinCountShift) & ~0xFF) &&
+         "Count of biased locks not in a byte");
   LockTable = (FatLock* **)
     allocator.Allocate(GlobalSize * sizeof(FatLock**), "Global LockTable");
   LockTable[0] = (FatLock**)
@@ -423,6 +512,35 @@ FatLock* LockSystem::getFatLockFromID(word_t ID) {
   }
 }
 
+void LockSystem::deflateLocks() {
+  gc* obj = NULL;
+  llvm_gcroot(obj, 0);
+  for (uint32_t i = 0; i < GlobalSize; i++) {
+    FatLock** array = LockTable[i];
+    if (array == NULL) break;
+    for (uint32_t j = 0; j < IndexSize; j++) {
+      FatLock* lock = array[j];
+      if (lock == NULL) break;
+      obj = lock->associatedObject;
+      if (obj == NULL) continue;
+      if (lock->getOwner() != NULL || lock->waitingThreads ||
+          lock->lockingThreads || lock->firstThread) {
+        continue;
+      }
+      // The lock may have been allocated for a thin lock being inflated.
+      if ((obj->header() & ~ThinLock::NonLockBitsMask) != lock->getID()) {
+        continue;
+      }
+      obj->header() &= ThinLock::NonLockBitsMask;
+      // Mutators never reach a GC point while manipulating the free list,
+      // so it can be updated without taking threadLock.
+      lock->associatedObject = NULL;
+      lock->nextFreeLock = freeLock;
+      freeLock = lock;
+    }
+  }
+}
+
 
 
 bool LockingThread::wait(
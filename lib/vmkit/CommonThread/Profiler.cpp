@@ -0,0 +1,326 @@
+//===------------- Profiler.cpp - Sampling profiler of VMKit --------------===//
+//
+//                     The VMKit project
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vmkit/MethodInfo.h"
+#include "vmkit/Profiler.h"
+#include "vmkit/System.h"
+#include "vmkit/Thread.h"
+#include "vmkit/VirtualMachine.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <map>
+#include <pthread.h>
+#include <signal.h>
+#include <string>
+#include <sys/time.h>
+#include <ucontext.h>
+
+using namespace vmkit;
+
+uint32_t Profiler::Frequency = 0;
+const char* Profiler::OutputFile = NULL;
+
+namespace {
+
+/// MaxDepth - The number of frames recorded in a sample. Deeper stacks are
+/// truncated at their root.
+///
+const uint32_t MaxDepth = 64;
+
+/// BufferSize - The number of samples of the buffer. Samples taken while
+/// the buffer is full are dropped.
+///
+const uint32_t BufferSize = 4096;
+
+/// Sample - The program counter of the interrupted code, followed by the
+/// return addresses of the stack.
+///
+struct Sample {
+  /// sequence - The position in the buffer the sample can be written at,
+  /// or that position plus one once the sample is written.
+  ///
+  volatile word_t sequence;
+  uint32_t depth;
+  word_t ips[MaxDepth];
+};
+
+/// CodeRange - The end and the method of compiled code.
+///
+struct CodeRange {
+  word_t end;
+  void* metadata;
+};
+
+Sample* Samples = NULL;
+volatile word_t WriteIndex = 0;
+word_t ReadIndex = 0;
+volatile word_t DroppedSamples = 0;
+
+VirtualMachine* ProfiledVM = NULL;
+pthread_t AggregatorThread;
+volatile bool Running = false;
+volatile bool Stopping = false;
+volatile sig_atomic_t DumpRequested = 0;
+void (*PreviousExitHook)() = NULL;
+
+// The profiler is used by threads that are not VMKit threads, so it uses a
+// pthread mutex instead of a VMKit lock. It protects the maps below.
+pthread_mutex_t ProfileLock = PTHREAD_MUTEX_INITIALIZER;
+std::map<word_t, CodeRange> CodeRanges;
+std::map<void*, std::string> MethodNames;
+std::map<std::string, uint64_t> Stacks;
+uint64_t TotalSamples = 0;
+
+bool getContext(void* context, word_t& pc, word_t& fp) {
+#if defined(ARCH_X64) && defined(LINUX_OS)
+  pc = ((ucontext_t*)context)->uc_mcontext.gregs[REG_RIP];
+  fp = ((ucontext_t*)context)->uc_mcontext.gregs[REG_RBP];
+  return true;
+#elif defined(ARCH_X86) && defined(LINUX_OS)
+  pc = ((ucontext_t*)context)->uc_mcontext.gregs[REG_EIP];
+  fp = ((ucontext_t*)context)->uc_mcontext.gregs[REG_EBP];
+  return true;
+#elif defined(ARCH_X64) && defined(MACOS_OS)
+  pc = ((ucontext_t*)context)->uc_mcontext->__ss.__rip;
+  fp = ((ucontext_t*)context)->uc_mcontext->__ss.__rbp;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void sigprofHandler(int n, siginfo_t* info, void* context) {
+  // Only walk the stacks of VMKit threads, whose bounds are known.
+  Thread* th = Thread::get();
+  if (!th->isVmkitThread()) return;
+
+  word_t pc = 0;
+  word_t fp = 0;
+  if (!getContext(context, pc, fp)) return;
+
+  int savedErrno = errno;
+  word_t pos = WriteIndex;
+  Sample* sample = NULL;
+  while (true) {
+    sample = &Samples[pos & (BufferSize - 1)];
+    word_t sequence = sample->sequence;
+    if (sequence == pos) {
+      if (__sync_bool_compare_and_swap(&WriteIndex, pos, pos + 1)) break;
+      pos = WriteIndex;
+    } else if (sequence < pos) {
+      // The aggregator has not drained this sample yet.
+      __sync_fetch_and_add(&DroppedSamples, 1);
+      errno = savedErrno;
+      return;
+    } else {
+      pos = WriteIndex;
+    }
+  }
+
+  // JIT code keeps the frame pointer. Stop at the first frame pointer that
+  // is not in the stack of the thread, in case native code does not.
+  word_t low = System::GetCallerAddress();
+  uint32_t depth = 0;
+  sample->ips[depth++] = pc;
+  while (depth < MaxDepth && fp > low && fp < th->baseSP &&
+         (fp & (sizeof(word_t) - 1)) == 0) {
+    sample->ips[depth++] = System::GetIPFromCallerAddress(fp);
+    word_t caller = System::GetCallerOfAddress(fp);
+    if (caller <= fp) break;
+    fp = caller;
+  }
+  sample->depth = depth;
+  __sync_synchronize();
+  sample->sequence = pos + 1;
+  errno = savedErrno;
+}
+
+void sigusr2Handler(int n) {
+  DumpRequested = 1;
+}
+
+void* lookupCode(word_t pc) {
+  std::map<word_t, CodeRange>::iterator I = CodeRanges.upper_bound(pc);
+  if (I == CodeRanges.begin()) return NULL;
+  --I;
+  return (pc < I->second.end) ? I->second.metadata : NULL;
+}
+
+const std::string& getName(void* metadata) {
+  std::map<void*, std::string>::iterator I = MethodNames.find(metadata);
+  if (I != MethodNames.end()) return I->second;
+  char buffer[512];
+  ProfiledVM->getMethodName(metadata, buffer, sizeof(buffer));
+  // Semicolons separate the frames of collapsed stacks.
+  for (char* cur = buffer; *cur; ++cur) {
+    if (*cur == ';' || *cur == ' ') *cur = '_';
+  }
+  return MethodNames[metadata] = buffer;
+}
+
+// Called with the lock held.
+void aggregate(Sample* sample) {
+  void* frames[MaxDepth];
+  uint32_t nbFrames = 0;
+  for (uint32_t i = 0; i < sample->depth; ++i) {
+    void* metadata = NULL;
+    if (i == 0) {
+      metadata = lookupCode(sample->ips[0]);
+    } else {
+      metadata = ProfiledVM->IPToFrameInfo(sample->ips[i])->Metadata;
+    }
+    // Merge consecutive frames of native code.
+    if (metadata == NULL && nbFrames > 0 && frames[nbFrames - 1] == NULL) {
+      continue;
+    }
+    frames[nbFrames++] = metadata;
+  }
+  // Drop the native frames that started the thread.
+  while (nbFrames > 0 && frames[nbFrames - 1] == NULL) --nbFrames;
+
+  std::string stack;
+  if (nbFrames == 0) {
+    stack = "[vm]";
+  } else {
+    for (uint32_t i = nbFrames; i > 0; --i) {
+      if (i != nbFrames) stack += ';';
+      if (frames[i - 1] == NULL) stack += "[native]";
+      else stack += getName(frames[i - 1]);
+    }
+  }
+  ++Stacks[stack];
+  ++TotalSamples;
+}
+
+void drain() {
+  pthread_mutex_lock(&ProfileLock);
+  while (true) {
+    Sample* sample = &Samples[ReadIndex & (BufferSize - 1)];
+    if (sample->sequence != ReadIndex + 1) break;
+    __sync_synchronize();
+    aggregate(sample);
+    __sync_synchronize();
+    sample->sequence = ReadIndex + BufferSize;
+    ++ReadIndex;
+  }
+  pthread_mutex_unlock(&ProfileLock);
+}
+
+void writeProfile() {
+  char defaultFile[64];
+  const char* fileName = Profiler::OutputFile;
+  if (fileName == NULL) {
+    snprintf(defaultFile, sizeof(defaultFile), "profile-%d.collapsed",
+             getpid());
+    fileName = defaultFile;
+  }
+  FILE* file = fopen(fileName, "w");
+  if (file == NULL) {
+    fprintf(stderr, "Can not write the profile to %s\n", fileName);
+    return;
+  }
+  pthread_mutex_lock(&ProfileLock);
+  for (std::map<std::string, uint64_t>::iterator I = Stacks.begin(),
+       E = Stacks.end(); I != E; ++I) {
+    fprintf(file, "%s %llu\n", I->first.c_str(), (unsigned long long)I->second);
+  }
+  fprintf(stderr, "Wrote a profile of %llu samples (%llu dropped) to %s\n",
+          (unsigned long long)TotalSamples,
+          (unsigned long long)DroppedSamples, fileName);
+  pthread_mutex_unlock(&ProfileLock);
+  fclose(file);
+}
+
+void* aggregatorStart(void* arg) {
+  // Samples are only taken on VMKit threads, but do not let the timer
+  // interrupt the sleeps of the aggregator.
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGPROF);
+  sigaddset(&mask, SIGUSR2);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+  while (!Stopping) {
+    usleep(100 * 1000);
+    drain();
+    if (DumpRequested) {
+      DumpRequested = 0;
+      writeProfile();
+    }
+  }
+  return NULL;
+}
+
+void stopAtExit() {
+  Profiler::stop();
+  if (PreviousExitHook != NULL) PreviousExitHook();
+}
+
+}
+
+void Profiler::start(VirtualMachine* vm) {
+  if (Frequency == 0 || Running) return;
+  ProfiledVM = vm;
+  Samples = new Sample[BufferSize];
+  for (uint32_t i = 0; i < BufferSize; ++i) {
+    Samples[i].sequence = i;
+    Samples[i].depth = 0;
+  }
+
+  if (pthread_create(&AggregatorThread, NULL, aggregatorStart, NULL) != 0) {
+    fprintf(stderr, "Can not create the profiler thread\n");
+    return;
+  }
+  Running = true;
+  PreviousExitHook = System::ExitHook;
+  System::ExitHook = stopAtExit;
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_SIGINFO | SA_RESTART;
+  sa.sa_sigaction = sigprofHandler;
+  sigaction(SIGPROF, &sa, NULL);
+
+  memset(&sa, 0, sizeof(sa));
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sa.sa_handler = sigusr2Handler;
+  sigaction(SIGUSR2, &sa, NULL);
+
+  uint32_t period = 1000000 / Frequency;
+  if (period == 0) period = 1;
+  struct itimerval timer;
+  timer.it_interval.tv_sec = period / 1000000;
+  timer.it_interval.tv_usec = period % 1000000;
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+void Profiler::stop() {
+  if (!__sync_bool_compare_and_swap(&Running, true, false)) return;
+  struct itimerval timer;
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_PROF, &timer, NULL);
+  Stopping = true;
+  pthread_join(AggregatorThread, NULL);
+  drain();
+  writeProfile();
+}
+
+void Profiler::registerCode(void* code, size_t size, void* metadata) {
+  if (Frequency == 0) return;
+  CodeRange range;
+  range.end = (word_t)code + size;
+  range.metadata = metadata;
+  pthread_mutex_lock(&ProfileLock);
+  CodeRanges[(word_t)code] = range;
+  pthread_mutex_unlock(&ProfileLock);
+}
@@ -254,10 +254,30 @@ word_t Thread::waitOnSP() {
 
 
 word_t Thread::baseAddr = 0;
+void (*System::ExitHook)() = NULL;
 
-// These could be set at runtime.
-#define STACK_SIZE 0x100000
-#define NR_THREADS 255
+/// STACK_SIZE - The size of the slot of a thread. The Thread object is at the
+/// bottom of the slot, and the stack grows down from at most the top of the
+/// slot.
+#define STACK_SIZE kThreadSlotSize
+
+/// DEFAULT_STACK_SIZE - The stack size of threads when -Xss is not given.
+#define DEFAULT_STACK_SIZE (STACK_SIZE < 0x100000 ? STACK_SIZE : 0x100000)
+
+/// NR_THREADS - The number of slots in the range reserved for threads.
+#define NR_THREADS ((~kVmkitThreadMask + 1) / STACK_SIZE)
+
+/// STACK_OVERFLOW_LIMIT - Offset in the slot under which the stack pointer
+/// of Java code is considered to overflow (see Thread::StackOverflowMask).
+/// Stacks must be bigger than that.
+#define STACK_OVERFLOW_LIMIT ((~Thread::StackOverflowMask & (STACK_SIZE - 1)) + 1)
+
+/// MIN_STACK_SIZE - The minimal size of a stack, so that Java code can run at
+/// least a few frames before overflowing.
+#define MIN_STACK_SIZE (STACK_OVERFLOW_LIMIT + 0x10000)
+
+word_t Thread::DefaultStackSize = DEFAULT_STACK_SIZE;
+const word_t Thread::MaxStackSize = STACK_SIZE;
 
 /// StackThreadManager - This class allocates all stacks for threads. Because
 /// we want fast access to thread local data, and can not rely on platform
@@ -266,62 +286,90 @@ word_t Thread::baseAddr = 0;
 /// stack. A simple mask computes the thread local data , based on the current
 /// stack pointer.
 //
-/// The stacks are allocated at boot time. They must all be in the memory range
-/// 0x?0000000 and Ox(?+1)0000000, so that the thread local data can be computed
-/// and threads have a unique ID.
+/// The whole range of thread slots is reserved at boot time, but slots are
+/// only committed when a thread first needs them. They must all be in the
+/// kVmkitThreadMask-aligned range starting at kThreadStart, so that the
+/// thread local data can be computed and threads have a unique ID.
+///
+/// Released slots are kept in a free list, linked through the first word of
+/// the slot, so that allocating and releasing a slot is constant time.
 ///
 class StackThreadManager {
 public:
   word_t baseAddr;
   uint32 allocPtr;
-  uint32 used[NR_THREADS];
+  word_t freeList;
   LockNormal stackLock;
 
   StackThreadManager() {
     baseAddr = 0;
     word_t ptr = kThreadStart;
 
-    uint32 flags = MAP_PRIVATE | MAP_ANON | MAP_FIXED;
+    uint32 flags = MAP_PRIVATE | MAP_ANON | MAP_FIXED | MAP_NORESERVE;
     baseAddr = (word_t)mmap((void*)ptr, STACK_SIZE * NR_THREADS,
-                               PROT_READ | PROT_WRITE, flags, -1, 0);
+                               PROT_NONE, flags, -1, 0);
 
     if (baseAddr == (word_t) MAP_FAILED) {
       fprintf(stderr, "Can not allocate thread memory\n");
       abort();
     }
  
-    // Protect the page after the alternative stack.
-    uint32 pagesize = System::GetPageSize();
-    for (uint32 i = 0; i < NR_THREADS; ++i) {
-      word_t addr = baseAddr + (i * STACK_SIZE) + pagesize
-        + vmkit::System::GetAlternativeStackSize();
-      mprotect((void*)addr, pagesize, PROT_NONE);
-    }
-
-    memset((void*)used, 0, NR_THREADS * sizeof(uint32));
     allocPtr = 0;
+    freeList = 0;
     vmkit::Thread::baseAddr = baseAddr;
   }
 
+  /// commit - Make a fresh slot usable. Protect the page after the
+  /// alternative stack, to catch stack overflows.
+  bool commit(word_t slot) {
+    uint32 flags = MAP_PRIVATE | MAP_ANON | MAP_FIXED | MAP_NORESERVE;
+    void* res = mmap((void*)slot, STACK_SIZE, PROT_READ | PROT_WRITE, flags,
+                     -1, 0);
+    if (res == MAP_FAILED) return false;
+
+    uint32 pagesize = System::GetPageSize();
+    word_t addr = slot + pagesize + vmkit::System::GetAlternativeStackSize();
+    mprotect((void*)addr, pagesize, PROT_NONE);
+    return true;
+  }
+
   word_t allocate() {
+    word_t slot = 0;
     stackLock.lock();
-    uint32 myIndex = 0;
-    do {
-      if (!used[myIndex]) {
-        used[myIndex] = 1;
-        break;
+    if (freeList) {
+      slot = freeList;
+      freeList = *(word_t*)slot;
+    } else if (allocPtr != NR_THREADS) {
+      slot = baseAddr + allocPtr * STACK_SIZE;
+      if (commit(slot)) {
+        ++allocPtr;
+      } else {
+        slot = 0;
       }
-      ++myIndex;
-    } while (myIndex != NR_THREADS);
-  
+    }
     stackLock.unlock();
-    
-    if (myIndex != NR_THREADS)
-      return baseAddr + myIndex * STACK_SIZE;
+    return slot;
+  }
 
-    return 0;
+  void release(word_t slot) {
+    // Give the memory of the stack back to the system. The guard page keeps
+    // its protection.
+    madvise((void*)slot, STACK_SIZE, MADV_DONTNEED);
+    stackLock.lock();
+    *(word_t*)slot = freeList;
+    freeList = slot;
+    stackLock.unlock();
   }
 
+  /// stackSize - The size of the stack given to pthread for a thread that
+  /// asked for the given size.
+  static word_t stackSize(word_t size) {
+    if (size == 0) size = Thread::DefaultStackSize;
+    size = System::PageAlignUp(size);
+    if (size < MIN_STACK_SIZE) size = MIN_STACK_SIZE;
+    if (size > STACK_SIZE) size = STACK_SIZE;
+    return size;
+  }
 };
 
 
@@ -382,7 +430,10 @@ void Thread::internalThreadStart(vmkit::Thread* th) {
 int Thread::start(void (*fct)(vmkit::Thread*)) {
   pthread_attr_t attributs;
   pthread_attr_init(&attributs);
-  pthread_attr_setstack(&attributs, this, STACK_SIZE);
+  // The stack grows down from this + size: the Thread object is always at the
+  // bottom of the slot, whatever the size of the stack.
+  pthread_attr_setstack(&attributs, this,
+                        StackThreadManager::stackSize(stackSize));
   routine = fct;
   // Make sure to add it in the list of threads before leaving this function:
   // the garbage collector wants to trace this thread.
@@ -397,12 +448,11 @@ int Thread::start(void (*fct)(vmkit::Thread*)) {
 /// operator new - Get a stack from the stack manager. The Thread object
 /// will be placed in the first page at the bottom of the stack. Hence
 /// Thread objects can not exceed a page.
-void* Thread::operator new(size_t sz) {
+void* Thread::operator new(size_t sz) throw() {
   assert(sz < (size_t)getpagesize() && "Thread local data too big");
   void* res = (void*)TheStackManager.allocate();
   // Make sure the thread information is cleared.
   if (res != NULL) memset(res, 0, sz);
-  assert(res && "Thread cannot be allocated because there is no room available");
   return res;
 }
 
@@ -417,9 +467,7 @@ void Thread::releaseThread(vmkit::Thread* th) {
     // Wait for the thread to die.
     pthread_join((pthread_t)thread_id, NULL);
   }
-  word_t index = ((word_t)th & System::GetThreadIDMask());
-  index = (index & ~TheStackManager.baseAddr) >> 20;
-  TheStackManager.used[index] = 0;
+  TheStackManager.release((word_t)th & System::GetThreadIDMask());
 }
 
 void Thread::throwNullPointerException(word_t methodIP)
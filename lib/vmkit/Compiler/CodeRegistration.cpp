@@ -0,0 +1,217 @@
+//===------ CodeRegistration.cpp - Publish JIT code to external tools -----===//
+//
+//                     The VMKit project
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Compiled functions are published to perf through the /tmp/perf-<pid>.map
+// file, and to gdb through its JIT interface: gdb puts a breakpoint on
+// __jit_debug_register_code and reads the in-memory object file describing
+// the new code from __jit_debug_descriptor.
+//
+//===----------------------------------------------------------------------===//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#if defined(__ELF__)
+#include <elf.h>
+#include <link.h>
+#endif
+
+#include "vmkit/JIT.h"
+#include "vmkit/Locks.h"
+
+using namespace vmkit;
+
+bool VmkitModule::EmitPerfMap = false;
+bool VmkitModule::EmitGDBSymbols = false;
+
+static FILE* PerfMapFile = NULL;
+
+// Compiler threads register their code concurrently.
+static LockNormal RegistrationLock;
+
+void VmkitModule::openPerfMap() {
+  if (PerfMapFile != NULL) return;
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/perf-%d.map", getpid());
+  PerfMapFile = fopen(path, "w");
+  if (PerfMapFile == NULL) {
+    fprintf(stderr, "Can not open %s, perf symbols are disabled\n", path);
+    EmitPerfMap = false;
+  }
+}
+
+static void writePerfMap(const char* name, void* code, size_t size) {
+  if (PerfMapFile == NULL) return;
+  fprintf(PerfMapFile, "%lx %lx %s\n", (unsigned long)code,
+          (unsigned long)size, name);
+  // perf may read the file while the VM runs, or after it crashed.
+  fflush(PerfMapFile);
+}
+
+extern "C" {
+  // The interface gdb expects. LLVM defines the same symbols when it
+  // registers the objects of MCJIT, so the definitions are weak.
+  enum { JIT_NOACTION = 0, JIT_REGISTER_FN, JIT_UNREGISTER_FN };
+
+  struct jit_code_entry {
+    jit_code_entry* next_entry;
+    jit_code_entry* prev_entry;
+    const char* symfile_addr;
+    uint64_t symfile_size;
+  };
+
+  struct jit_descriptor {
+    uint32_t version;
+    uint32_t action_flag;
+    jit_code_entry* relevant_entry;
+    jit_code_entry* first_entry;
+  };
+
+  __attribute__((weak, noinline)) void __jit_debug_register_code() {
+    __asm__ __volatile__("");
+  }
+
+  __attribute__((weak)) jit_descriptor __jit_debug_descriptor =
+    { 1, JIT_NOACTION, NULL, NULL };
+}
+
+#if defined(__ELF__)
+
+#if defined(__x86_64__)
+static const uint16_t ELFMachine = EM_X86_64;
+#elif defined(__i386__)
+static const uint16_t ELFMachine = EM_386;
+#elif defined(__powerpc64__)
+static const uint16_t ELFMachine = EM_PPC64;
+#elif defined(__powerpc__)
+static const uint16_t ELFMachine = EM_PPC;
+#elif defined(__arm__)
+static const uint16_t ELFMachine = EM_ARM;
+#else
+static const uint16_t ELFMachine = EM_NONE;
+#endif
+
+static const char SectionNames[] = "\0.text\0.symtab\0.strtab\0.shstrtab";
+enum { TextName = 1, SymtabName = 7, StrtabName = 15, ShstrtabName = 23 };
+enum { NullSection, TextSection, SymtabSection, StrtabSection,
+       ShstrtabSection, NumSections };
+
+static size_t alignTo(size_t offset, size_t alignment) {
+  return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+/// createSymbolFile - Create an executable ELF file with a symbol for the
+/// code. The text section has no contents: gdb reads the code from memory.
+///
+static char* createSymbolFile(const char* name, void* code, size_t size,
+                              size_t* fileSize) {
+  size_t nameLength = strlen(name) + 1;
+  size_t shstrtabOffset = sizeof(ElfW(Ehdr));
+  size_t strtabOffset = shstrtabOffset + sizeof(SectionNames);
+  size_t symtabOffset = alignTo(strtabOffset + 1 + nameLength, 8);
+  size_t sectionsOffset = alignTo(symtabOffset + 2 * sizeof(ElfW(Sym)), 8);
+  *fileSize = sectionsOffset + NumSections * sizeof(ElfW(Shdr));
+
+  char* file = (char*)calloc(1, *fileSize);
+  if (file == NULL) return NULL;
+
+  ElfW(Ehdr)* header = (ElfW(Ehdr)*)file;
+  memcpy(header->e_ident, ELFMAG, SELFMAG);
+  header->e_ident[EI_CLASS] = sizeof(void*) == 8 ? ELFCLASS64 : ELFCLASS32;
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+  header->e_ident[EI_DATA] = ELFDATA2LSB;
+#else
+  header->e_ident[EI_DATA] = ELFDATA2MSB;
+#endif
+  header->e_ident[EI_VERSION] = EV_CURRENT;
+  header->e_ident[EI_OSABI] = ELFOSABI_NONE;
+  header->e_type = ET_EXEC;
+  header->e_machine = ELFMachine;
+  header->e_version = EV_CURRENT;
+  header->e_shoff = sectionsOffset;
+  header->e_ehsize = sizeof(ElfW(Ehdr));
+  header->e_shentsize = sizeof(ElfW(Shdr));
+  header->e_shnum = NumSections;
+  header->e_shstrndx = ShstrtabSection;
+
+  memcpy(file + shstrtabOffset, SectionNames, sizeof(SectionNames));
+  // The string table starts with the empty string.
+  memcpy(file + strtabOffset + 1, name, nameLength);
+
+  ElfW(Sym)* symbol = (ElfW(Sym)*)(file + symtabOffset) + 1;
+  symbol->st_name = 1;
+  symbol->st_info = ELF32_ST_INFO(STB_GLOBAL, STT_FUNC);
+  symbol->st_shndx = TextSection;
+  symbol->st_value = (word_t)code;
+  symbol->st_size = size;
+
+  ElfW(Shdr)* sections = (ElfW(Shdr)*)(file + sectionsOffset);
+  sections[TextSection].sh_name = TextName;
+  sections[TextSection].sh_type = SHT_NOBITS;
+  sections[TextSection].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+  sections[TextSection].sh_addr = (word_t)code;
+  sections[TextSection].sh_size = size;
+  sections[TextSection].sh_addralign = 16;
+
+  sections[SymtabSection].sh_name = SymtabName;
+  sections[SymtabSection].sh_type = SHT_SYMTAB;
+  sections[SymtabSection].sh_offset = symtabOffset;
+  sections[SymtabSection].sh_size = 2 * sizeof(ElfW(Sym));
+  sections[SymtabSection].sh_link = StrtabSection;
+  // The index of the first global symbol.
+  sections[SymtabSection].sh_info = 1;
+  sections[SymtabSection].sh_addralign = 8;
+  sections[SymtabSection].sh_entsize = sizeof(ElfW(Sym));
+
+  sections[StrtabSection].sh_name = StrtabName;
+  sections[StrtabSection].sh_type = SHT_STRTAB;
+  sections[StrtabSection].sh_offset = strtabOffset;
+  sections[StrtabSection].sh_size = 1 + nameLength;
+  sections[StrtabSection].sh_addralign = 1;
+
+  sections[ShstrtabSection].sh_name = ShstrtabName;
+  sections[ShstrtabSection].sh_type = SHT_STRTAB;
+  sections[ShstrtabSection].sh_offset = shstrtabOffset;
+  sections[ShstrtabSection].sh_size = sizeof(SectionNames);
+  sections[ShstrtabSection].sh_addralign = 1;
+
+  return file;
+}
+
+static void registerWithGDB(const char* name, void* code, size_t size) {
+  size_t fileSize = 0;
+  char* file = createSymbolFile(name, code, size, &fileSize);
+  if (file == NULL) return;
+  jit_code_entry* entry = new jit_code_entry();
+  entry->symfile_addr = file;
+  entry->symfile_size = fileSize;
+  entry->prev_entry = NULL;
+  entry->next_entry = __jit_debug_descriptor.first_entry;
+  if (entry->next_entry != NULL) entry->next_entry->prev_entry = entry;
+  __jit_debug_descriptor.first_entry = entry;
+  __jit_debug_descriptor.relevant_entry = entry;
+  __jit_debug_descriptor.action_flag = JIT_REGISTER_FN;
+  __jit_debug_register_code();
+}
+
+#else
+
+static void registerWithGDB(const char* name, void* code, size_t size) {
+}
+
+#endif
+
+void VmkitModule::registerCode(const char* name, void* code, size_t size) {
+  RegistrationLock.lock();
+  if (EmitPerfMap) writePerfMap(name, code, size);
+  if (EmitGDBSymbols) registerWithGDB(name, code, size);
+  RegistrationLock.unlock();
+}
@@ -191,17 +191,41 @@ static void AddStandardCompilePasses(FunctionPassManager* PM) {
   addPass(PM, createCFGSimplificationPass());     // Merge & remove BBs
 }
 
+// Passes run after the standard compile passes on hot methods. They give
+// the loop optimisations a second chance, now that the standard passes have
+// cleaned up the code and hoisted the checks out of the loops.
+//
+static void AddLoopOptimisationPasses(FunctionPassManager* PM,
+                                      FunctionPass* loopPass) {
+  addPass(PM, createEarlyCSEPass());             // Catch trivial redundancies
+  addPass(PM, createLoopRotatePass());           // Rotate loops.
+  addPass(PM, createLICMPass());                 // Hoist loop invariants
+  if (loopPass) addPass(PM, loopPass);           // VM specific loop pass
+  addPass(PM, createLoopIdiomPass());            // Recognize memset / memcpy
+  addPass(PM, createIndVarSimplifyPass());       // Canonicalize indvars
+  addPass(PM, createLoopDeletionPass());         // Delete dead loops
+  addPass(PM, createLoopUnrollPass());           // Unroll small loops
+  addPass(PM, createInstructionCombiningPass()); // Clean up after the unroller
+  addPass(PM, createGVNPass());                  // Remove redundancies
+  addPass(PM, createCorrelatedValuePropagationPass()); // Propagate conditions
+  addPass(PM, createDeadStoreEliminationPass()); // Delete dead stores
+  addPass(PM, createAggressiveDCEPass());        // Delete dead instructions
+  addPass(PM, createCFGSimplificationPass());    // Merge & remove BBs
+}
+
 namespace vmkit {
   llvm::FunctionPass* createInlineMallocPass();
 }
 
-void VmkitModule::addCommandLinePasses(FunctionPassManager* PM) {
+static void AddCommandLinePasses(FunctionPassManager* PM, bool optimising,
+                                 FunctionPass* loopPass) {
   addPass(PM, createVerifierPass());        // Verify that input is correct
 
   addPass(PM, createCFGSimplificationPass()); // Clean up disgusting code
   addPass(PM, createInlineMallocPass());
 
   if (DisableOptimizations) {
+    delete loopPass;
     PM->doInitialization();
     return;
   }
@@ -239,6 +263,39 @@ void VmkitModule::addCommandLinePasses(FunctionPassManager* PM) {
     AddStandardCompilePasses(PM);
   }
 
+  if (StandardCompileOpts && optimising) {
+    AddLoopOptimisationPasses(PM, loopPass);
+  } else {
+    delete loopPass;
+  }
+
+  PM->doInitialization();
+}
+
+void VmkitModule::addCommandLinePasses(FunctionPassManager* PM) {
+  AddCommandLinePasses(PM, false, NULL);
+}
+
+void VmkitModule::addOptimisingPasses(FunctionPassManager* PM,
+                                      FunctionPass* loopPass) {
+  AddCommandLinePasses(PM, true, loopPass);
+}
+
+void VmkitModule::addBaselinePasses(FunctionPassManager* PM) {
+  addPass(PM, createVerifierPass());        // Verify that input is correct
+
+  addPass(PM, createCFGSimplificationPass()); // Clean up disgusting code
+  addPass(PM, createInlineMallocPass());
+
+  if (DisableOptimizations) {
+    PM->doInitialization();
+    return;
+  }
+
+  addPass(PM, createPromoteMemoryToRegisterPass()); // Kill useless allocas
+  addPass(PM, createEarlyCSEPass());                // Catch trivial redundancies
+  addPass(PM, createCFGSimplificationPass());       // Merge & remove BBs
+
   PM->doInitialization();
 }
 
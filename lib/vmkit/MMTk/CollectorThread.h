@@ -0,0 +1,161 @@
+//===--------- CollectorThread.h - Threads for parallel GC ----------------===//
+//
+//                     The VMKit project
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef VMKIT_COLLECTOR_THREAD_H
+#define VMKIT_COLLECTOR_THREAD_H
+
+#include "vmkit/Cond.h"
+#include "vmkit/Locks.h"
+#include "MutatorThread.h"
+
+namespace vmkit {
+
+class VirtualMachine;
+
+/// CollectorThread - A thread dedicated to garbage collection. Collector
+/// threads never execute Java code: they sleep until a collection is
+/// triggered, and then execute the MMTk collection phases in parallel with
+/// the thread that triggered the collection.
+///
+class CollectorThread : public MutatorThread {
+public:
+  CollectorThread(VirtualMachine* vm) : MutatorThread() {
+    MyVM = vm;
+    Ordinal = 0;
+    LastCollection = 0;
+  }
+
+  /// Ordinal - The ordinal of this thread among the collector threads. The
+  /// thread that triggers a collection always has ordinal 0.
+  ///
+  uint32_t Ordinal;
+
+  /// LastCollection - The last collection this thread took part in.
+  ///
+  uint32_t LastCollection;
+
+  /// collectorStart - The routine of collector threads.
+  ///
+  static void collectorStart(CollectorThread* th);
+
+  /// start - Start the thread. Collector threads do not have a mutator
+  /// context, so bypass MutatorThread::start.
+  ///
+  virtual int start(void (*fct)(vmkit::Thread*)) {
+    return Thread::start(fct);
+  }
+};
+
+/// ParallelCollector - The pool of collector threads, and the barrier the
+/// MMTk phases use to synchronize them.
+///
+class ParallelCollector {
+  /// MaxThreads - Upper bound on the number of collector threads. It matches
+  /// ImmixConstants.MAX_COLLECTORS in MMTk.
+  ///
+  static const uint32_t MaxThreads = 16;
+
+  /// NumberOfThreads - Number of threads taking part in a collection,
+  /// including the thread that triggers it.
+  ///
+  static uint32_t NumberOfThreads;
+
+  /// ReadyThreads - Number of collector threads waiting for work.
+  ///
+  static uint32_t ReadyThreads;
+
+  /// ActiveThreads - Number of threads taking part in the current
+  /// collection, including the thread that triggered it.
+  ///
+  static uint32_t ActiveThreads;
+
+  /// RunningThreads - Number of collector threads that have not finished the
+  /// current collection yet.
+  ///
+  static uint32_t RunningThreads;
+
+  /// CollectionNumber - Incremented each time collector threads are woken up.
+  ///
+  static uint32_t CollectionNumber;
+
+  /// ArrivedThreads - Number of threads that reached the current barrier.
+  ///
+  static uint32_t ArrivedThreads;
+
+  /// BarrierNumber - Incremented each time all threads pass a barrier.
+  ///
+  static uint32_t BarrierNumber;
+
+  /// Started - Have the collector threads been created?
+  ///
+  static uint32_t Started;
+
+  static LockNormal PoolLock;
+  static Cond WorkCond;
+  static Cond DoneCond;
+  static Cond BarrierCond;
+
+public:
+
+  /// setNumberOfThreads - Set the number of threads taking part in a
+  /// collection. Must be called before the first collection.
+  ///
+  static void setNumberOfThreads(uint32_t nb);
+
+  /// startThreads - Create the collector threads of the given VM, if not
+  /// already done.
+  ///
+  static void startThreads(VirtualMachine* vm);
+
+  /// beginCollection - Wake up the collector threads. Called by the thread
+  /// triggering the collection, once all mutators have joined the rendezvous.
+  ///
+  static void beginCollection();
+
+  /// endCollection - Wait for all collector threads to finish the current
+  /// collection.
+  ///
+  static void endCollection();
+
+  /// waitForCollection - Called by collector threads to wait until the next
+  /// collection.
+  ///
+  static void waitForCollection(CollectorThread* th);
+
+  /// finishCollection - Called by collector threads when they have executed
+  /// all phases of the current collection.
+  ///
+  static void finishCollection(CollectorThread* th);
+
+  /// registerThread - Make the collector thread available for collections.
+  ///
+  static void registerThread(CollectorThread* th);
+
+  /// rendezvous - Block until all active threads reached the barrier. Returns
+  /// the rank of the current thread, 1 being the primary thread.
+  ///
+  static int rendezvous();
+
+  /// activeThreads - Number of threads taking part in the current collection.
+  ///
+  static uint32_t activeThreads() { return ActiveThreads; }
+
+  /// maxThreads - Number of threads that may take part in a collection.
+  ///
+  static uint32_t maxThreads() { return NumberOfThreads; }
+
+  /// currentOrdinal - The ordinal of the current thread in the collection.
+  ///
+  static uint32_t currentOrdinal();
+};
+
+}
+
+#endif
@@ -20,10 +20,16 @@ class MutatorThread : public vmkit::Thread {
 public:
   MutatorThread() : vmkit::Thread() {
     MutatorContext = 0;
+    CollectorContext = 0;
     CollectionAttempts = 0;
   }
   vmkit::ThreadAllocator Allocator;
   word_t MutatorContext;
+
+  /// CollectorContext - The MMTk collector context of this thread, if this
+  /// thread is a collector thread.
+  ///
+  word_t CollectorContext;
   
   /// realRoutine - The function to invoke when the thread starts.
   ///
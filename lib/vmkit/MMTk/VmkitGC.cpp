@@ -11,6 +11,7 @@
 #include "MutatorThread.h"
 #include "vmkit/VirtualMachine.h"
 
+#include <cstring>
 #include <set>
 
 using namespace vmkit;
@@ -207,6 +208,14 @@ bool Collector::objectReferenceTryCASBarrier(gc*ref, gc** slot, gc* old, gc* val
   return (old == res);
 }
 
+void Collector::objectReferenceArrayCopyBarrier(gc* src, gc** srcSlot,
+                                                gc* dst, gc** dstSlot,
+                                                size_t length) {
+  llvm_gcroot(src, 0);
+  llvm_gcroot(dst, 0);
+  memmove(dstSlot, srcSlot, length * sizeof(gc*));
+}
+
 void Collector::collect() {
   // Do nothing.
 }
@@ -214,6 +223,24 @@ void Collector::collect() {
 void Collector::initialise(int argc, char** argv) {
 }
 
+size_t Collector::getMaxMemory() {
+  return 0;
+}
+
+size_t Collector::getFreeMemory() {
+  return 0;
+}
+
+size_t Collector::getTotalMemory() {
+  return 0;
+}
+
+void Collector::setMaxMemory(size_t sz) {
+}
+
+void Collector::setMinMemory(size_t sz) {
+}
+
 bool Collector::needsWriteBarrier() {
   return false;
 }
@@ -221,3 +248,8 @@ bool Collector::needsWriteBarrier() {
 bool Collector::needsNonHeapWriteBarrier() {
   return false;
 }
+
+bool Collector::pinObject(gc* obj) {
+  // Objects are allocated with malloc, and never move.
+  return true;
+}
@@ -54,30 +54,49 @@ public:
   static void objectReferenceArrayWriteBarrier(gc* ref, gc** slot, gc* value) __attribute__ ((always_inline));
   static void objectReferenceNonHeapWriteBarrier(gc** slot, gc* value) __attribute__ ((always_inline));
   static bool objectReferenceTryCASBarrier(gc* ref, gc** slot, gc* old, gc* value) __attribute__ ((always_inline));
+
+  /// objectReferenceArrayCopyBarrier - Copy length references of the array
+  /// src, starting at srcSlot, to the array dst, starting at dstSlot. The
+  /// ranges may overlap. The references are moved in bulk if the barrier
+  /// allows it.
+  ///
+  static void objectReferenceArrayCopyBarrier(gc* src, gc** srcSlot, gc* dst,
+                                              gc** dstSlot, size_t length);
+
   static bool needsWriteBarrier() __attribute__ ((always_inline));
   static bool needsNonHeapWriteBarrier() __attribute__ ((always_inline));
 
+  /// pinObject - Make sure the object never moves, so that its address can
+  /// be handed out to native code. Returns false if the collector can not
+  /// pin the object.
+  ///
+  static bool pinObject(gc* obj);
+
   static void collect();
   
   static void initialise(int argc, char** argv);
   
-  static int getMaxMemory() {
-    return 0;
-  }
-  
-  static int getFreeMemory() {
-    return 0;
-  }
-  
-  static int getTotalMemory() {
-    return 0;
-  }
+  /// getMaxMemory - The maximum size the heap can grow to.
+  ///
+  static size_t getMaxMemory();
 
-  void setMaxMemory(size_t sz){
-  }
+  /// getFreeMemory - The amount of memory available in the current heap.
+  ///
+  static size_t getFreeMemory();
 
-  void setMinMemory(size_t sz){
-  }
+  /// getTotalMemory - The current size of the heap.
+  ///
+  static size_t getTotalMemory();
+
+  /// setMaxMemory - Set the maximum heap size. Must be called before
+  /// initialise.
+  ///
+  static void setMaxMemory(size_t sz);
+
+  /// setMinMemory - Set the initial heap size. Must be called before
+  /// initialise.
+  ///
+  static void setMinMemory(size_t sz);
 
   static void* begOf(gc*);
 };
@@ -7,9 +7,6 @@
 //
 //===----------------------------------------------------------------------===//
 
-#include "llvm/ADT/DenseMap.h"
-#include "llvm/ADT/DenseSet.h"
-
 #include "vmkit/Allocator.h"
 #include "vmkit/MethodInfo.h"
 #include "vmkit/VirtualMachine.h"
@@ -42,9 +39,23 @@ void MethodInfoHelper::print(word_t ip, word_t addr) {
 }
 
 
+FrameInfoTable* FrameInfoTable::create(uint32_t capacity) {
+  size_t size = sizeof(FrameInfoTable) + (capacity - 1) * sizeof(FrameInfo*);
+  FrameInfoTable* res = reinterpret_cast<FrameInfoTable*>(new char[size]);
+  memset(res, 0, size);
+  res->Capacity = capacity;
+  return res;
+}
+
+static uint32_t hashIP(word_t ip) {
+  return (uint32_t)((ip >> 2) ^ (ip >> 18));
+}
+
 FunctionMap::FunctionMap(BumpPtrAllocator& allocator, CompiledFrames** allFrames) {
+  // Make sure the table is big enough for the frames of a precompiled VM.
+  Functions = FrameInfoTable::create(allFrames ? 65536 : 4096);
+  NumFunctions = 0;
   if (allFrames == NULL) return;
-  Functions.resize(32000); // Make sure the cache is big enough.
   int i = 0;
   CompiledFrames* compiledFrames = NULL;
   while ((compiledFrames = allFrames[i++]) != NULL) {
@@ -72,20 +83,56 @@ FunctionMap::FunctionMap(BumpPtrAllocator& allocator, CompiledFrames** allFrames
 static FrameInfo emptyInfo;
 
 FrameInfo* FunctionMap::IPToFrameInfo(word_t ip) {
-  FunctionMapLock.acquire();
-  llvm::DenseMap<word_t, FrameInfo*>::iterator I = Functions.find(ip);
+  // The table and the FrameInfo it points to are published after being
+  // initialized, so they can be read without the lock.
+  FrameInfoTable* table = Functions;
+  uint32_t mask = table->Capacity - 1;
+  uint32_t index = hashIP(ip) & mask;
   FrameInfo* res = NULL;
-  if (I != Functions.end()) {
-    res = I->second;
-  } else {
-    assert(emptyInfo.Metadata == NULL);
-    assert(emptyInfo.NumLiveOffsets == 0);
-    res = &emptyInfo;
+  while ((res = table->Entries[index]) != NULL) {
+    if (res->ReturnAddress == ip) return res;
+    index = (index + 1) & mask;
   }
-  FunctionMapLock.release();
-  return res;
+  assert(emptyInfo.Metadata == NULL);
+  assert(emptyInfo.NumLiveOffsets == 0);
+  return &emptyInfo;
+}
+
+void FunctionMap::grow() {
+  FrameInfoTable* table = Functions;
+  FrameInfoTable* newTable = FrameInfoTable::create(table->Capacity * 2);
+  uint32_t mask = newTable->Capacity - 1;
+  for (uint32_t i = 0; i < table->Capacity; ++i) {
+    FrameInfo* frame = table->Entries[i];
+    if (frame == NULL) continue;
+    uint32_t index = hashIP(frame->ReturnAddress) & mask;
+    while (newTable->Entries[index] != NULL) {
+      index = (index + 1) & mask;
+    }
+    newTable->Entries[index] = frame;
+  }
+  newTable->Next = table;
+  __sync_synchronize();
+  Functions = newTable;
 }
 
+void FunctionMap::addFrameInfoNoLock(word_t ip, FrameInfo* meth) {
+  assert(meth->ReturnAddress == ip && "Wrong return address");
+  // Keep the load factor under 1/2.
+  if (2 * (NumFunctions + 1) > Functions->Capacity) grow();
+  FrameInfoTable* table = Functions;
+  uint32_t mask = table->Capacity - 1;
+  uint32_t index = hashIP(ip) & mask;
+  FrameInfo* cur = NULL;
+  while ((cur = table->Entries[index]) != NULL) {
+    if (cur->ReturnAddress == ip) break;
+    index = (index + 1) & mask;
+  }
+  if (cur == NULL) ++NumFunctions;
+  // Make the contents of the FrameInfo visible before publishing it.
+  __sync_synchronize();
+  table->Entries[index] = meth;
+}
 
 void FunctionMap::addFrameInfo(word_t ip, FrameInfo* meth) {
   FunctionMapLock.acquire();
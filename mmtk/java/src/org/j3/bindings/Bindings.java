@@ -11,6 +11,7 @@ package org.j3.bindings;
 
 import org.j3.config.Selected;
 import org.j3.options.OptionSet;
+import org.mmtk.plan.CollectorContext;
 import org.mmtk.plan.MutatorContext;
 import org.mmtk.plan.Plan;
 import org.mmtk.plan.TraceLocal;
@@ -131,6 +132,18 @@ public final class Bindings {
     mutator.deinitMutator();
   }
 
+  @Inline
+  private static CollectorContext allocateCollector(int id) {
+    Selected.Collector collector = new Selected.Collector();
+    collector.initCollector(id);
+    return collector;
+  }
+
+  @Inline
+  private static void parallelCollect() {
+    Selected.Collector.get().collect();
+  }
+
   @Inline
   private static void boot(Extent minSize, Extent maxSize, String[] arguments) {
     if (arguments != null) {
@@ -143,17 +156,40 @@ public final class Bindings {
     plan.fullyBooted();
   }
 
+  @Inline
+  private static Extent maxMemory() {
+    return HeapGrowthManager.getMaxHeapSize();
+  }
+
+  @Inline
+  private static Extent totalMemory() {
+    return Plan.totalMemory();
+  }
+
+  @Inline
+  private static Extent freeMemory() {
+    return Plan.freeMemory();
+  }
+
+  // Plans that can pin the object (e.g. Immix) do so, plans that can not
+  // keep it in place return false.
+  @Inline
+  private static boolean willNeverMove(ObjectReference obj) {
+    return Selected.Plan.get().willNeverMove(obj);
+  }
+
   @Inline
   private static ObjectReference copy(ObjectReference from,
                               ObjectReference virtualTable,
                               int size,
+                              int extraSize,
                               int allocator) {
 	int wholeSize = size + hiddenHeaderSize();
     Selected.Collector plan = Selected.Collector.get();
-    allocator = plan.copyCheckAllocator(from, wholeSize, 0, allocator);
-    Address to = plan.allocCopy(from, wholeSize, 0, 0, allocator);
+    allocator = plan.copyCheckAllocator(from, wholeSize + extraSize, 0, allocator);
+    Address to = plan.allocCopy(from, wholeSize + extraSize, 0, 0, allocator);
     memcpy(to, from.toAddress(), wholeSize);
-    plan.postCopy(to.toObjectReference(), virtualTable, size, allocator);
+    plan.postCopy(to.toObjectReference(), virtualTable, size + extraSize, allocator);
     return to.toObjectReference();
   }
 
@@ -212,6 +248,24 @@ public final class Bindings {
     }
   }
 
+  // Returns true if the references can be copied with a plain memory move:
+  // either the plan does not need a barrier, or it recorded the whole range.
+  // Otherwise, each reference must go through the array write barrier.
+  @Inline
+  private static boolean arrayCopyWriteBarrier(ObjectReference src, Offset srcOffset, ObjectReference dst, Offset dstOffset, int bytes) {
+    if (!Selected.Constraints.get().needsObjectReferenceWriteBarrier()) {
+      return true;
+    }
+    if (!Selected.Constraints.get().objectReferenceBulkCopySupported()) {
+      return false;
+    }
+    Selected.Mutator mutator = Selected.Mutator.get();
+    boolean copied = mutator.objectReferenceBulkCopy(src, srcOffset, dst, dstOffset, bytes);
+    // The plans supporting bulk copies leave the copy to the caller.
+    if (VM.VERIFY_ASSERTIONS) VM.assertions._assert(!copied);
+    return true;
+  }
+
   @Inline
   private static boolean needsWriteBarrier() {
     return Selected.Constraints.get().needsObjectReferenceWriteBarrier();
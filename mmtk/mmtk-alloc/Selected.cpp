@@ -7,13 +7,16 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "CollectorThread.h"
 #include "MutatorThread.h"
 #include "VmkitGC.h"
+#include "../mmtk-j3/GCStatistics.h"
 #include "../mmtk-j3/MMTkObject.h"
 
 #include "vmkit/VirtualMachine.h"
 
 #include <sys/mman.h>
+#include <cstring>
 #include <set>
 
 #include "debug.h"
@@ -234,22 +237,103 @@ gc* Collector::getForwardedReferent(gc* val, word_t closure) {
 void Collector::collect() {
   Java_org_j3_mmtk_Collection_triggerCollection__I(0, 2);
 }
+
+extern "C" uint8_t JnJVM_org_j3_bindings_Bindings_willNeverMove__Lorg_vmmagic_unboxed_ObjectReference_2(gc* obj) ALWAYS_INLINE;
+
+bool Collector::pinObject(gc* obj) {
+  llvm_gcroot(obj, 0);
+  return JnJVM_org_j3_bindings_Bindings_willNeverMove__Lorg_vmmagic_unboxed_ObjectReference_2(obj);
+}
   
+// Default heap sizes, when not given on the command line.
+static size_t MinHeapSize = 20 * 1024 * 1024;
+static size_t MaxHeapSize = 100 * 1024 * 1024;
+
+void Collector::setMinMemory(size_t sz) {
+  MinHeapSize = sz;
+}
+
+void Collector::setMaxMemory(size_t sz) {
+  MaxHeapSize = sz;
+}
+
+extern "C" word_t JnJVM_org_j3_bindings_Bindings_maxMemory__() ALWAYS_INLINE;
+extern "C" word_t JnJVM_org_j3_bindings_Bindings_totalMemory__() ALWAYS_INLINE;
+extern "C" word_t JnJVM_org_j3_bindings_Bindings_freeMemory__() ALWAYS_INLINE;
+
+size_t Collector::getMaxMemory() {
+  return JnJVM_org_j3_bindings_Bindings_maxMemory__();
+}
+
+size_t Collector::getTotalMemory() {
+  return JnJVM_org_j3_bindings_Bindings_totalMemory__();
+}
+
+size_t Collector::getFreeMemory() {
+  return JnJVM_org_j3_bindings_Bindings_freeMemory__();
+}
+
+/// parseHeapOption - Handle -Xms, -Xmx, -ms and -mx. Returns true if the
+/// option is a heap size option.
+static bool parseHeapOption(const char* option) {
+  const char* name = option + 1;
+  if (name[0] == 'X') name++;
+  if (strncmp(name, "ms", 2) && strncmp(name, "mx", 2)) return false;
+  size_t size = System::ParseMemorySize(name + 2);
+  if (size == 0) {
+    fprintf(stderr, "Invalid heap size: %s\n", option);
+    return true;
+  }
+  if (name[1] == 's') {
+    Collector::setMinMemory(size);
+  } else {
+    Collector::setMaxMemory(size);
+  }
+  return true;
+}
+
 static const char* kPrefix = "-X:gc:";
 static const int kPrefixLength = strlen(kPrefix);
+static const char* kThreadsOption = "-X:gc:threads=";
+static const int kThreadsOptionLength = strlen(kThreadsOption);
+static const char* kTelemetryOption = "-X:gc:telemetry=";
+static const int kTelemetryOptionLength = strlen(kTelemetryOption);
+
+/// isMMTkOption - Return true if the option must be given to MMTk. Options
+/// that are handled by VMKit itself are consumed here.
+static bool isMMTkOption(const char* option) {
+  if (strncmp(option, kPrefix, kPrefixLength)) return false;
+  if (!strncmp(option, kThreadsOption, kThreadsOptionLength)) {
+    ParallelCollector::setNumberOfThreads(
+        atoi(option + kThreadsOptionLength));
+    return false;
+  }
+  if (!strncmp(option, kTelemetryOption, kTelemetryOptionLength)) {
+    mmtk::GCStatistics::OutputFile = option + kTelemetryOptionLength;
+    return false;
+  }
+  return true;
+}
 
 void Collector::initialise(int argc, char** argv) {
   int i = 1;
   int count = 0;
   ThreadAllocator allocator;
   mmtk::MMTkObjectArray* arguments = NULL;
+  ParallelCollector::setNumberOfThreads(System::GetNumberOfProcessors());
   while (i < argc && argv[i][0] == '-') {
-    if (!strncmp(argv[i], kPrefix, kPrefixLength)) {
+    if (parseHeapOption(argv[i])) {
+      // Nothing to give to MMTk.
+    } else if (isMMTkOption(argv[i])) {
       count++;
     }
     i++;
   }
 
+  // The heap can not grow past the memory range reserved at boot time.
+  if (MaxHeapSize > kGCMemorySize) MaxHeapSize = kGCMemorySize;
+  if (MinHeapSize > MaxHeapSize) MinHeapSize = MaxHeapSize;
+
   if (count > 0) {
     arguments = reinterpret_cast<mmtk::MMTkObjectArray*>(
         malloc(sizeof(mmtk::MMTkObjectArray) + count * sizeof(mmtk::MMTkString*)));
@@ -257,7 +341,7 @@ void Collector::initialise(int argc, char** argv) {
     i = 1;
     int arrayIndex = 0;
     while (i < argc && argv[i][0] == '-') {
-      if (!strncmp(argv[i], kPrefix, kPrefixLength)) {
+      if (isMMTkOption(argv[i])) {
         int size = strlen(argv[i]) - kPrefixLength;
         mmtk::MMTkArray* array = reinterpret_cast<mmtk::MMTkArray*>(
             allocator.Allocate(sizeof(mmtk::MMTkArray) + size * sizeof(uint16_t)));
@@ -277,7 +361,8 @@ void Collector::initialise(int argc, char** argv) {
     assert(arrayIndex == count);
   }
 
-  JnJVM_org_j3_bindings_Bindings_boot__Lorg_vmmagic_unboxed_Extent_2Lorg_vmmagic_unboxed_Extent_2_3Ljava_lang_String_2(20 * 1024 * 1024, 100 * 1024 * 1024, arguments);
+  JnJVM_org_j3_bindings_Bindings_boot__Lorg_vmmagic_unboxed_Extent_2Lorg_vmmagic_unboxed_Extent_2_3Ljava_lang_String_2(MinHeapSize, MaxHeapSize, arguments);
+  mmtk::GCStatistics::initialise();
 }
 
 extern "C" void* MMTkMutatorAllocate(uint32_t size, void* type) {
@@ -317,6 +402,30 @@ bool Collector::objectReferenceTryCASBarrier(gc* ref, gc** slot, gc* old, gc* va
   return res;
 }
 
+extern "C" uint8_t JnJVM_org_j3_bindings_Bindings_arrayCopyWriteBarrier__Lorg_vmmagic_unboxed_ObjectReference_2Lorg_vmmagic_unboxed_Offset_2Lorg_vmmagic_unboxed_ObjectReference_2Lorg_vmmagic_unboxed_Offset_2I(gc* src, word_t srcOffset, gc* dst, word_t dstOffset, int32_t bytes) ALWAYS_INLINE;
+
+void Collector::objectReferenceArrayCopyBarrier(gc* src, gc** srcSlot,
+                                                gc* dst, gc** dstSlot,
+                                                size_t length) {
+  llvm_gcroot(src, 0);
+  llvm_gcroot(dst, 0);
+  word_t srcOffset = (word_t)srcSlot - (word_t)src;
+  word_t dstOffset = (word_t)dstSlot - (word_t)dst;
+  if (JnJVM_org_j3_bindings_Bindings_arrayCopyWriteBarrier__Lorg_vmmagic_unboxed_ObjectReference_2Lorg_vmmagic_unboxed_Offset_2Lorg_vmmagic_unboxed_ObjectReference_2Lorg_vmmagic_unboxed_Offset_2I(src, srcOffset, dst, dstOffset, length * sizeof(gc*))) {
+    memmove(dstSlot, srcSlot, length * sizeof(gc*));
+  } else if (dstSlot > srcSlot && dstSlot < srcSlot + length) {
+    // The ranges overlap: copy backward.
+    for (size_t i = length; i > 0; --i) {
+      arrayWriteBarrier((void*)dst, (void**)(dstSlot + i - 1),
+                        (void*)srcSlot[i - 1]);
+    }
+  } else {
+    for (size_t i = 0; i < length; ++i) {
+      arrayWriteBarrier((void*)dst, (void**)(dstSlot + i), (void*)srcSlot[i]);
+    }
+  }
+}
+
 extern "C" uint8_t JnJVM_org_j3_bindings_Bindings_needsWriteBarrier__() ALWAYS_INLINE;
 extern "C" uint8_t JnJVM_org_j3_bindings_Bindings_needsNonHeapWriteBarrier__() ALWAYS_INLINE;
 
@@ -9,36 +9,52 @@
 
 #include "debug.h"
 #include "vmkit/VirtualMachine.h"
+#include "CollectorThread.h"
 #include "MMTkObject.h"
 #include "MutatorThread.h"
 
 namespace mmtk {
 
+// Collector threads iterate over mutators concurrently during mutator phases.
+// Once the iteration is over, it stays over until the primary collector
+// resets it.
+static vmkit::SpinLock MutatorIteratorLock;
+static bool MutatorIteratorDone = false;
+
 extern "C" MMTkObject* Java_org_j3_mmtk_ActivePlan_getNextMutator__(MMTkActivePlan* A) {
   assert(A && "No active plan");
-  
-  if (A->current == NULL) {
-    A->current = (vmkit::MutatorThread*)vmkit::Thread::get()->MyVM->mainThread;
-  } else if (A->current->next() == vmkit::Thread::get()->MyVM->mainThread) {
-    A->current = NULL;
+  vmkit::Thread* mainThread = vmkit::Thread::get()->MyVM->mainThread;
+  MMTkObject* res = NULL;
+
+  MutatorIteratorLock.acquire();
+  if (MutatorIteratorDone) {
+    MutatorIteratorLock.release();
     return NULL;
-  } else {
-    A->current = (vmkit::MutatorThread*)A->current->next();
   }
+  do {
+    if (A->current == NULL) {
+      A->current = (vmkit::MutatorThread*)mainThread;
+    } else if (A->current->next() == mainThread) {
+      A->current = NULL;
+      MutatorIteratorDone = true;
+      break;
+    } else {
+      A->current = (vmkit::MutatorThread*)A->current->next();
+    }
+    res = (MMTkObject*)A->current->MutatorContext;
+  } while (res == NULL);
+  MutatorIteratorLock.release();
 
-  if (A->current->MutatorContext == 0) {
-    return Java_org_j3_mmtk_ActivePlan_getNextMutator__(A);
-  }
-  return (MMTkObject*)A->current->MutatorContext;
+  return res;
 }
 
 extern "C" void Java_org_j3_mmtk_ActivePlan_resetMutatorIterator__(MMTkActivePlan* A) {
   A->current = NULL;
+  MutatorIteratorDone = false;
 }
 
 extern "C" int Java_org_j3_mmtk_ActivePlan_collectorCount__ (MMTkActivePlan* A) {
-  // We do not support parallel GC yet.
-  return 1;
+  return vmkit::ParallelCollector::maxThreads();
 }
 
 }
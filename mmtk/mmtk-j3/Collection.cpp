@@ -9,9 +9,144 @@
 
 #include "debug.h"
 #include "vmkit/VirtualMachine.h"
+#include "CollectorThread.h"
+#include "GCStatistics.h"
 #include "MMTkObject.h"
 #include "VmkitGC.h"
 
+namespace vmkit {
+
+extern "C" word_t JnJVM_org_j3_bindings_Bindings_allocateCollector__I(int32_t);
+extern "C" void JnJVM_org_j3_bindings_Bindings_parallelCollect__();
+
+uint32_t ParallelCollector::NumberOfThreads = 1;
+uint32_t ParallelCollector::ReadyThreads = 0;
+uint32_t ParallelCollector::ActiveThreads = 1;
+uint32_t ParallelCollector::RunningThreads = 0;
+uint32_t ParallelCollector::CollectionNumber = 0;
+uint32_t ParallelCollector::ArrivedThreads = 0;
+uint32_t ParallelCollector::BarrierNumber = 0;
+uint32_t ParallelCollector::Started = 0;
+LockNormal ParallelCollector::PoolLock;
+Cond ParallelCollector::WorkCond;
+Cond ParallelCollector::DoneCond;
+Cond ParallelCollector::BarrierCond;
+
+void ParallelCollector::setNumberOfThreads(uint32_t nb) {
+  if (nb == 0) nb = 1;
+  if (nb > MaxThreads) nb = MaxThreads;
+  NumberOfThreads = nb;
+}
+
+void ParallelCollector::startThreads(VirtualMachine* vm) {
+  if (NumberOfThreads == 1) return;
+  if (!__sync_bool_compare_and_swap(&Started, 0, 1)) return;
+
+  // The thread triggering a collection takes part in it, so only create
+  // NumberOfThreads - 1 threads.
+  // There may be no slot left for new threads. The collections then use
+  // the threads that registered.
+  for (uint32_t i = 1; i < NumberOfThreads; ++i) {
+    CollectorThread* th = new CollectorThread(vm);
+    if (th == NULL) break;
+    if (th->start((void (*)(vmkit::Thread*))CollectorThread::collectorStart)) {
+      break;
+    }
+  }
+}
+
+void ParallelCollector::registerThread(CollectorThread* th) {
+  PoolLock.lock();
+  th->Ordinal = ++ReadyThreads;
+  th->CollectorContext =
+    JnJVM_org_j3_bindings_Bindings_allocateCollector__I(th->Ordinal);
+  // Only take part in the collections starting from now on.
+  th->LastCollection = CollectionNumber;
+  PoolLock.unlock();
+}
+
+void ParallelCollector::beginCollection() {
+  PoolLock.lock();
+  ActiveThreads = ReadyThreads + 1;
+  RunningThreads = ReadyThreads;
+  ArrivedThreads = 0;
+  ++CollectionNumber;
+  WorkCond.broadcast();
+  PoolLock.unlock();
+}
+
+void ParallelCollector::endCollection() {
+  PoolLock.lock();
+  while (RunningThreads != 0) {
+    DoneCond.wait(&PoolLock);
+  }
+  ActiveThreads = 1;
+  PoolLock.unlock();
+}
+
+void ParallelCollector::waitForCollection(CollectorThread* th) {
+  PoolLock.lock();
+  while (th->LastCollection == CollectionNumber) {
+    WorkCond.wait(&PoolLock);
+  }
+  th->LastCollection = CollectionNumber;
+  PoolLock.unlock();
+}
+
+void ParallelCollector::finishCollection(CollectorThread* th) {
+  PoolLock.lock();
+  assert(RunningThreads > 0 && "Inconsistent collector count");
+  if (--RunningThreads == 0) {
+    DoneCond.broadcast();
+  }
+  PoolLock.unlock();
+}
+
+uint32_t ParallelCollector::currentOrdinal() {
+  vmkit::Thread* th = vmkit::Thread::get();
+  if (th == th->MyVM->rendezvous.getInitiator()) return 0;
+  return ((CollectorThread*)th)->Ordinal;
+}
+
+int ParallelCollector::rendezvous() {
+  // The thread that triggered the collection is always the primary thread:
+  // it is the one that owns the rendezvous of mutators.
+  int rank = currentOrdinal() + 1;
+  if (ActiveThreads == 1) return rank;
+
+  PoolLock.lock();
+  uint32_t barrier = BarrierNumber;
+  if (++ArrivedThreads == ActiveThreads) {
+    ArrivedThreads = 0;
+    ++BarrierNumber;
+    BarrierCond.broadcast();
+  } else {
+    while (barrier == BarrierNumber) {
+      BarrierCond.wait(&PoolLock);
+    }
+  }
+  PoolLock.unlock();
+  return rank;
+}
+
+void CollectorThread::collectorStart(CollectorThread* th) {
+  // Collector threads never execute cooperative code. Stay in uncooperative
+  // code forever so that rendezvous count this thread as joined, and mark the
+  // thread as being in a rendezvous so that it never tries to join one.
+  th->enterUncooperativeCode();
+  th->inRV = true;
+
+  ParallelCollector::registerThread(th);
+
+  while (true) {
+    ParallelCollector::waitForCollection(th);
+    JnJVM_org_j3_bindings_Bindings_parallelCollect__();
+    ParallelCollector::finishCollection(th);
+  }
+}
+
+}
+
 namespace mmtk {
 
 extern "C" bool Java_org_j3_mmtk_Collection_isEmergencyAllocation__ (MMTkObject* C) {
@@ -30,19 +165,37 @@ extern "C" void Java_org_j3_mmtk_Collection_triggerCollection__I (MMTkObject* C,
   if (why > 2) th->CollectionAttempts++;
 
   // Verify that another collection is not happening.
+  vmkit::ParallelCollector::startThreads(th->MyVM);
+
   th->MyVM->rendezvous.startRV();
   if (th->MyVM->rendezvous.getInitiator() != NULL) {
     th->MyVM->rendezvous.cancelRV();
     th->MyVM->rendezvous.join();
     return;
   } else {
+    CollectionRecord record;
+    record.reason = why;
+    record.start = GCStatistics::nanoTime();
     th->MyVM->startCollection();
     th->MyVM->rendezvous.synchronize();
+    th->MyVM->mutatorsStopped();
+    record.stopped = GCStatistics::nanoTime();
+    record.usedBefore =
+      vmkit::Collector::getTotalMemory() - vmkit::Collector::getFreeMemory();
+    GCStatistics::readCounters(record.countersBefore);
+    vmkit::ParallelCollector::beginCollection();
 
     JnJVM_org_j3_bindings_Bindings_collect__I(why);
 
+    vmkit::ParallelCollector::endCollection();
+    GCStatistics::readCounters(record.countersAfter);
+    record.usedAfter =
+      vmkit::Collector::getTotalMemory() - vmkit::Collector::getFreeMemory();
+    record.collected = GCStatistics::nanoTime();
     th->MyVM->rendezvous.finishRV();
     th->MyVM->endCollection();
+    record.end = GCStatistics::nanoTime();
+    GCStatistics::recordCollection(record);
   }
 
 }
@@ -54,7 +207,7 @@ extern "C" void Java_org_j3_mmtk_Collection_joinCollection__ (MMTkObject* C) {
 }
 
 extern "C" int Java_org_j3_mmtk_Collection_rendezvous__I (MMTkObject* C, int where) {
-  return 1;
+  return vmkit::ParallelCollector::rendezvous();
 }
 
 extern "C" int Java_org_j3_mmtk_Collection_maximumCollectionAttempt__ (MMTkObject* C) {
@@ -79,8 +232,13 @@ extern "C" void Java_org_j3_mmtk_Collection_prepareCollector__Lorg_mmtk_plan_Col
 extern "C" void Java_org_j3_mmtk_Collection_prepareMutator__Lorg_mmtk_plan_MutatorContext_2 (MMTkObject* C, MMTkObject* MC) {
 }
 
-extern "C" int32_t Java_org_j3_mmtk_Collection_activeGCThreads__ (MMTkObject* C) { return 1; }
-extern "C" int32_t Java_org_j3_mmtk_Collection_activeGCThreadOrdinal__ (MMTkObject* C) { return 1; }
+extern "C" int32_t Java_org_j3_mmtk_Collection_activeGCThreads__ (MMTkObject* C) {
+  return vmkit::ParallelCollector::activeThreads();
+}
+
+extern "C" int32_t Java_org_j3_mmtk_Collection_activeGCThreadOrdinal__ (MMTkObject* C) {
+  return vmkit::ParallelCollector::currentOrdinal();
+}
 
 
 extern "C" void Java_org_j3_mmtk_Collection_reportPhysicalAllocationFailed__ (MMTkObject* C) { UNIMPLEMENTED(); }
@@ -0,0 +1,104 @@
+//===--------- GCStatistics.h - Telemetry of the garbage collector --------===//
+//
+//                              The VMKit project
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MMTK_GC_STATISTICS_H
+#define MMTK_GC_STATISTICS_H
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace mmtk {
+
+/// MaxPerfEvents - The maximum number of hardware counters.
+///
+const uint32_t MaxPerfEvents = 8;
+
+/// CollectionRecord - The measures of one collection, taken by the thread
+/// that triggered it.
+///
+struct CollectionRecord {
+  /// reason - Why the collection was triggered, one of the triggers of
+  /// org.mmtk.vm.Collection.
+  ///
+  int32_t reason;
+
+  /// start - When the collection was requested.
+  ///
+  uint64_t start;
+
+  /// stopped - When all mutators reached the rendezvous.
+  ///
+  uint64_t stopped;
+
+  /// collected - When MMTk finished the collection.
+  ///
+  uint64_t collected;
+
+  /// end - When the mutators were released.
+  ///
+  uint64_t end;
+
+  /// usedBefore - The bytes used in the heap when the mutators stopped.
+  ///
+  size_t usedBefore;
+
+  /// usedAfter - The bytes used in the heap after the collection.
+  ///
+  size_t usedAfter;
+
+  /// countersBefore - The hardware counters when the mutators stopped.
+  ///
+  uint64_t countersBefore[MaxPerfEvents];
+
+  /// countersAfter - The hardware counters after the collection.
+  ///
+  uint64_t countersAfter[MaxPerfEvents];
+};
+
+/// GCStatistics - Pause times, phase timings, hardware counters and
+/// allocation rate of the collections. With -X:gc:telemetry=<file>, one JSON
+/// object is written per line to the file: one per collection, and a summary
+/// with the pause histogram when the process receives SIGUSR1 and at exit.
+///
+class GCStatistics {
+public:
+
+  /// OutputFile - The file to write the telemetry to, or null if it is
+  /// disabled.
+  ///
+  static const char* OutputFile;
+
+  /// initialise - Open the output file and start the thread waiting for
+  /// SIGUSR1. Must be called before other threads are created, so that they
+  /// inherit the blocked signal.
+  ///
+  static void initialise();
+
+  /// nanoTime - A monotonic clock, in nanoseconds.
+  ///
+  static uint64_t nanoTime();
+
+  /// readCounters - Read the current value of the hardware counters opened
+  /// by perfEventInit.
+  ///
+  static void readCounters(uint64_t* values);
+
+  /// recordCollection - Account a finished collection, and write it to the
+  /// output file. Called after the mutators were released.
+  ///
+  static void recordCollection(CollectionRecord& record);
+
+  /// getCollectionCount - The number of collections so far.
+  ///
+  static uint32_t getCollectionCount();
+};
+
+} // namespace mmtk
+
+#endif
@@ -35,6 +35,11 @@ struct MMTkArray : public MMTkObject {
   uint16_t elements[1];
 };
 
+struct MMTkLongArray : public MMTkObject {
+  word_t size;
+  int64_t elements[1];
+};
+
 struct MMTkObjectArray : public MMTkObject {
   word_t size;
   MMTkObject* elements[1];
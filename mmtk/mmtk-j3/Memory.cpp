@@ -11,6 +11,7 @@
 #include "vmkit/VirtualMachine.h"
 #include "MMTkObject.h"
 
+#include <errno.h>
 #include <sys/mman.h>
 
 namespace mmtk {
@@ -18,8 +19,11 @@ namespace mmtk {
 class InitCollector {
 public:
   InitCollector() {
-    uint32 flags = MAP_PRIVATE | MAP_ANON | MAP_FIXED;
-    void* baseAddr = mmap((void*)vmkit::kGCMemoryStart, vmkit::kGCMemorySize, PROT_READ | PROT_WRITE,
+    // Only reserve the address range: pages are committed by dzmmap when
+    // MMTk maps a chunk, so the heap can grow up to kGCMemorySize without
+    // paying for it upfront.
+    uint32 flags = MAP_PRIVATE | MAP_ANON | MAP_FIXED | MAP_NORESERVE;
+    void* baseAddr = mmap((void*)vmkit::kGCMemoryStart, vmkit::kGCMemorySize, PROT_NONE,
                           flags, -1, 0);
     if (baseAddr == MAP_FAILED) {
       perror("mmap for GC memory");
@@ -28,9 +32,25 @@ public:
   }
 };
 
-// Allocate the memory for MMTk right now, to avoid conflicts with other allocators.
+// Reserve the memory for MMTk right now, to avoid conflicts with other allocators.
 InitCollector initCollector;
 
+// Ranges bigger than this are given back to the system instead of being
+// cleared when MMTk zeroes them.
+static const word_t kDecommitThreshold = 1024 * 1024;
+
+/// decommit - Release the physical pages of the range. The range stays
+/// mapped, and reads as zero the next time it is touched.
+static bool decommit(word_t start, word_t size) {
+  word_t first = vmkit::System::PageAlignUp(start);
+  word_t last = (start + size) & ~(word_t)(vmkit::System::GetPageSize() - 1);
+  if (last <= first || (last - first) < kDecommitThreshold) return false;
+  if (madvise((void*)first, last - first, MADV_DONTNEED) != 0) return false;
+  memset((void*)start, 0, first - start);
+  memset((void*)last, 0, start + size - last);
+  return true;
+}
+
 extern "C" word_t Java_org_j3_mmtk_Memory_getHeapStartConstant__ (MMTkObject* M) {
   return vmkit::kGCMemoryStart;
 }
@@ -51,7 +71,10 @@ extern "C" sint32
 Java_org_j3_mmtk_Memory_dzmmap__Lorg_vmmagic_unboxed_Address_2I(MMTkObject* M,
                                                                 void* start,
                                                                 sint32 size) {
-  // Already mmapped during initialization.
+  // The range was reserved during initialization, commit it now.
+  uint32 flags = MAP_PRIVATE | MAP_ANON | MAP_FIXED;
+  void* res = mmap(start, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (res == MAP_FAILED) return errno;
   return 0;
 }
 
@@ -71,12 +94,12 @@ extern "C" void
 Java_org_j3_mmtk_Memory_zero__Lorg_vmmagic_unboxed_Address_2Lorg_vmmagic_unboxed_Extent_2(MMTkObject* M,
                                                                                           void* addr,
                                                                                           word_t len) {
-  memset(addr, 0, len);
+  if (!decommit((word_t)addr, len)) memset(addr, 0, len);
 }
 
 extern "C" void
 Java_org_j3_mmtk_Memory_zeroPages__Lorg_vmmagic_unboxed_Address_2I (MMTkObject* M, word_t address, sint32 size) {
-  UNIMPLEMENTED();
+  if (!decommit(address, size)) memset((void*)address, 0, size);
 }
 
 extern "C" void
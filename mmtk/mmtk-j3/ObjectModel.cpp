@@ -101,8 +101,8 @@ extern "C" void Java_org_j3_bindings_Bindings_memcpy__Lorg_vmmagic_unboxed_Addre
 }
 
 
-extern "C" word_t JnJVM_org_j3_bindings_Bindings_copy__Lorg_vmmagic_unboxed_ObjectReference_2Lorg_vmmagic_unboxed_ObjectReference_2II(
-    gc* obj, void* type, int size, int allocator);
+extern "C" word_t JnJVM_org_j3_bindings_Bindings_copy__Lorg_vmmagic_unboxed_ObjectReference_2Lorg_vmmagic_unboxed_ObjectReference_2III(
+    gc* obj, void* type, int size, int extraSize, int allocator);
 
 extern "C" word_t Java_org_j3_mmtk_ObjectModel_copy__Lorg_vmmagic_unboxed_ObjectReference_2I (
     MMTkObject* OM, gc* src, int allocator) ALWAYS_INLINE;
@@ -113,10 +113,24 @@ extern "C" word_t Java_org_j3_mmtk_ObjectModel_copy__Lorg_vmmagic_unboxed_Object
   llvm_gcroot(res, 0);
   llvm_gcroot(src, 0);
   size_t size = vmkit::Thread::get()->MyVM->getObjectSize(src);
-  size = llvm::RoundUpToAlignment(size, sizeof(void*));
-  res = (gc*)JnJVM_org_j3_bindings_Bindings_copy__Lorg_vmmagic_unboxed_ObjectReference_2Lorg_vmmagic_unboxed_ObjectReference_2II(
-      src, vmkit::Thread::get()->MyVM->getType(src), size, allocator);
+  size = vmkit::HashSlotOffset(size);
+  word_t hashState = src->header() & vmkit::HashStateMask;
+  size_t extraSize = 0;
+  if (hashState == vmkit::HashedAndMovedState) {
+    // The hash slot moves with the object.
+    size += sizeof(word_t);
+  } else if (hashState == vmkit::HashedState) {
+    // The hash depends on the current address: append it to the copy.
+    extraSize = sizeof(word_t);
+  }
+  res = (gc*)JnJVM_org_j3_bindings_Bindings_copy__Lorg_vmmagic_unboxed_ObjectReference_2Lorg_vmmagic_unboxed_ObjectReference_2III(
+      src, vmkit::Thread::get()->MyVM->getType(src), size, extraSize, allocator);
   assert((res->header() & ~vmkit::GCBitMask) == (src->header() & ~vmkit::GCBitMask));
+  if (extraSize != 0) {
+    *(word_t*)((word_t)res + size) = vmkit::HashFromAddress((word_t)src);
+    res->header() = (res->header() & ~vmkit::HashStateMask) |
+        vmkit::HashedAndMovedState;
+  }
   return (word_t)res;
 }
 
@@ -130,7 +144,10 @@ extern "C" word_t Java_org_j3_mmtk_ObjectModel_getObjectEndAddress__Lorg_vmmagic
     MMTkObject* OM, gc* object) {
   llvm_gcroot(object, 0);
   size_t size = vmkit::Thread::get()->MyVM->getObjectSize(object);
-  size = llvm::RoundUpToAlignment(size, sizeof(void*));
+  size = vmkit::HashSlotOffset(size);
+  if ((object->header() & vmkit::HashStateMask) == vmkit::HashedAndMovedState) {
+    size += sizeof(word_t);
+  }
   return reinterpret_cast<word_t>(object) + size;
 }
 
@@ -9,33 +9,64 @@
 
 #include "debug.h"
 #include "vmkit/VirtualMachine.h"
+#include "CollectorThread.h"
 #include "MMTkObject.h"
 #include "VmkitGC.h"
 
 namespace mmtk {
 
+// Threads are handed out one at a time to the threads taking part in the
+// collection. A cursor points to the next thread of the ring to hand out: it
+// is null when no thread has been handed out since the last reset, and
+// AllThreadsClaimed when the whole ring has been handed out. The thread that
+// triggered the collection is not handed out: it is running the collection,
+// so only itself can walk its stack.
+static vmkit::Thread* volatile NextStackToScan = NULL;
+static vmkit::Thread* volatile NextThreadToTrace = NULL;
+static vmkit::Thread* const AllThreadsClaimed = (vmkit::Thread*)1;
+
+/// claimThread - Claim the next thread of the ring, or return null if all
+/// threads have been claimed.
+static vmkit::Thread* claimThread(vmkit::Thread* volatile* cursor) {
+  vmkit::Thread* initiator =
+    vmkit::Thread::get()->MyVM->rendezvous.getInitiator();
+  while (true) {
+    vmkit::Thread* cur = *cursor;
+    if (cur == AllThreadsClaimed) return NULL;
+    vmkit::Thread* claimed =
+      (cur != NULL) ? cur : (vmkit::Thread*)initiator->next();
+    if (claimed == initiator) {
+      // The initiator is the only thread.
+      __sync_bool_compare_and_swap(cursor, cur, AllThreadsClaimed);
+      return NULL;
+    }
+    vmkit::Thread* next = (vmkit::Thread*)claimed->next();
+    if (next == initiator) next = AllThreadsClaimed;
+    if (__sync_bool_compare_and_swap(cursor, cur, next)) return claimed;
+  }
+}
+
 extern "C" void Java_org_j3_mmtk_Scanning_computeThreadRoots__Lorg_mmtk_plan_TraceLocal_2 (MMTkObject* Scanning, MMTkObject* TL) {
   // When entering this function, all threads are waiting on the rendezvous to
-  // finish.
-  vmkit::Thread* th = vmkit::Thread::get();
-  vmkit::Thread* tcur = th;
-  
-  do {
+  // finish. The stacks are scanned by all threads of the collection.
+  vmkit::Thread* tcur = NULL;
+  if (vmkit::ParallelCollector::currentOrdinal() == 0) {
+    vmkit::Thread::get()->scanStack(reinterpret_cast<word_t>(TL));
+  }
+  while ((tcur = claimThread(&NextStackToScan)) != NULL) {
     tcur->scanStack(reinterpret_cast<word_t>(TL));
-    tcur = (vmkit::Thread*)tcur->next();
-  } while (tcur != th);
+  }
 }
 
 extern "C" void Java_org_j3_mmtk_Scanning_computeGlobalRoots__Lorg_mmtk_plan_TraceLocal_2 (MMTkObject* Scanning, MMTkObject* TL) { 
-  vmkit::Thread::get()->MyVM->tracer(reinterpret_cast<word_t>(TL));
-  
-	vmkit::Thread* th = vmkit::Thread::get();
-  vmkit::Thread* tcur = th;
-  
-  do {
+  vmkit::Thread* tcur = NULL;
+  if (vmkit::ParallelCollector::currentOrdinal() == 0) {
+    vmkit::Thread::get()->MyVM->tracer(reinterpret_cast<word_t>(TL));
+    vmkit::Thread::get()->tracer(reinterpret_cast<word_t>(TL));
+  }
+  while ((tcur = claimThread(&NextThreadToTrace)) != NULL) {
     tcur->tracer(reinterpret_cast<word_t>(TL));
-    tcur = (vmkit::Thread*)tcur->next();
-  } while (tcur != th);
+  }
 }
 
 extern "C" void Java_org_j3_mmtk_Scanning_computeStaticRoots__Lorg_mmtk_plan_TraceLocal_2 (MMTkObject* Scanning, MMTkObject* TL) {
@@ -43,7 +74,10 @@ extern "C" void Java_org_j3_mmtk_Scanning_computeStaticRoots__Lorg_mmtk_plan_Tra
 }
 
 extern "C" void Java_org_j3_mmtk_Scanning_resetThreadCounter__ (MMTkObject* Scanning) {
-  // Nothing to do.
+  // Called by the primary collector once all collectors have computed their
+  // roots.
+  NextStackToScan = NULL;
+  NextThreadToTrace = NULL;
 }
 
 extern "C" void Java_org_j3_mmtk_Scanning_specializedScanObject__ILorg_mmtk_plan_TransitiveClosure_2Lorg_vmmagic_unboxed_ObjectReference_2 (MMTkObject* Scanning, uint32_t id, MMTkObject* TC, gc* obj) ALWAYS_INLINE;
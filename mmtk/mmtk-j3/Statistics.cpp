@@ -2,47 +2,340 @@
 //
 //                              The VMKit project
 //
-// This file is distributed under the University of Illinois Open Source 
+// This file is distributed under the University of Illinois Open Source
 // License. See LICENSE.TXT for details.
 //
 //===----------------------------------------------------------------------===//
 
+#include "GCStatistics.h"
 #include "MMTkObject.h"
+#include "vmkit/System.h"
 
-#include <sys/time.h>
+#include <cstdio>
+#include <cstring>
 #include <ctime>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
 
 namespace mmtk {
 
-extern "C" int64_t Java_org_j3_mmtk_Statistics_cycles__ (MMTkObject* S) {
-  return 0;
-}
+const char* GCStatistics::OutputFile = NULL;
 
-extern "C" int64_t Java_org_j3_mmtk_Statistics_nanoTime__ (MMTkObject* S) {
-  int64_t result;
-  struct timeval tp; 
+/// NumberOfBuckets - The pause histogram has one bucket per power of two of
+/// microseconds: bucket i counts the pauses shorter than 2^i us.
+///
+static const uint32_t NumberOfBuckets = 32;
+
+// The statistics are updated by the thread that triggered a collection, and
+// read by the thread dumping them on SIGUSR1, which is not a VMKit thread.
+static pthread_mutex_t StatisticsLock = PTHREAD_MUTEX_INITIALIZER;
+static FILE* TelemetryFile = NULL;
+static uint32_t CollectionCount = 0;
+static uint64_t PauseHistogram[NumberOfBuckets];
+static uint64_t TotalPause = 0;
+static uint64_t MaxPause = 0;
+static uint64_t TotalSafepoint = 0;
+static uint64_t TotalAllocated = 0;
+static uint64_t BootTime = 0;
+static uint64_t LastCollectionEnd = 0;
+static size_t LastUsedAfter = 0;
+static void (*PreviousExitHook)() = NULL;
+
+static int PerfEventFds[MaxPerfEvents];
+static const char* PerfEventNames[MaxPerfEvents];
+static uint32_t NumberOfPerfEvents = 0;
 
-  int res = gettimeofday (&tp, NULL);
+uint64_t GCStatistics::nanoTime() {
+  struct timespec tp;
+  int res = clock_gettime(CLOCK_MONOTONIC, &tp);
   USE(res);
-  assert(res != -1 && "failed gettimeofday.");
+  assert(res != -1 && "failed clock_gettime.");
+  return (uint64_t)tp.tv_sec * 1000000000ULL + (uint64_t)tp.tv_nsec;
+}
+
+uint32_t GCStatistics::getCollectionCount() {
+  return CollectionCount;
+}
+
+static uint32_t getBucket(uint64_t pause) {
+  uint64_t micros = pause / 1000;
+  uint32_t bucket = 0;
+  while (micros != 0 && bucket < NumberOfBuckets - 1) {
+    micros >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+// Called with the lock held.
+static void writeSummary() {
+  if (TelemetryFile == NULL) return;
+  fprintf(TelemetryFile,
+          "{\"event\":\"summary\",\"uptime_ns\":%llu,\"collections\":%u,"
+          "\"pause_total_ns\":%llu,\"pause_max_ns\":%llu,"
+          "\"safepoint_total_ns\":%llu,\"allocated_bytes\":%llu,"
+          "\"pause_histogram_us\":{",
+          (unsigned long long)(GCStatistics::nanoTime() - BootTime),
+          CollectionCount, (unsigned long long)TotalPause,
+          (unsigned long long)MaxPause, (unsigned long long)TotalSafepoint,
+          (unsigned long long)TotalAllocated);
+  bool first = true;
+  for (uint32_t i = 0; i < NumberOfBuckets; ++i) {
+    if (PauseHistogram[i] == 0) continue;
+    fprintf(TelemetryFile, "%s\"%llu\":%llu", first ? "" : ",",
+            1ULL << i, (unsigned long long)PauseHistogram[i]);
+    first = false;
+  }
+  fprintf(TelemetryFile, "}}\n");
+  fflush(TelemetryFile);
+}
+
+void GCStatistics::recordCollection(CollectionRecord& record) {
+  uint64_t pause = record.end - record.start;
+  uint64_t allocated = 0;
+  if (record.usedBefore > LastUsedAfter) {
+    allocated = record.usedBefore - LastUsedAfter;
+  }
+  uint64_t interval = record.start - LastCollectionEnd;
+
+  pthread_mutex_lock(&StatisticsLock);
+  ++CollectionCount;
+  ++PauseHistogram[getBucket(pause)];
+  TotalPause += pause;
+  if (pause > MaxPause) MaxPause = pause;
+  TotalSafepoint += record.stopped - record.start;
+  TotalAllocated += allocated;
+  LastCollectionEnd = record.end;
+  LastUsedAfter = record.usedAfter;
+
+  if (TelemetryFile != NULL) {
+    fprintf(TelemetryFile,
+            "{\"event\":\"gc\",\"id\":%u,\"reason\":%d,\"start_ns\":%llu,"
+            "\"pause_ns\":%llu,\"safepoint_ns\":%llu,\"collect_ns\":%llu,"
+            "\"release_ns\":%llu,\"used_before\":%llu,\"used_after\":%llu,"
+            "\"allocated_bytes\":%llu,\"allocation_rate\":%llu",
+            CollectionCount, record.reason,
+            (unsigned long long)(record.start - BootTime),
+            (unsigned long long)pause,
+            (unsigned long long)(record.stopped - record.start),
+            (unsigned long long)(record.collected - record.stopped),
+            (unsigned long long)(record.end - record.collected),
+            (unsigned long long)record.usedBefore,
+            (unsigned long long)record.usedAfter,
+            (unsigned long long)allocated,
+            // In bytes per second of mutator time.
+            (unsigned long long)(interval ? allocated * 1000000000.0 / interval : 0));
+    if (NumberOfPerfEvents != 0) {
+      fprintf(TelemetryFile, ",\"counters\":{");
+      for (uint32_t i = 0; i < NumberOfPerfEvents; ++i) {
+        fprintf(TelemetryFile, "%s\"%s\":%llu", i ? "," : "",
+                PerfEventNames[i],
+                (unsigned long long)(record.countersAfter[i] -
+                                     record.countersBefore[i]));
+      }
+      fprintf(TelemetryFile, "}");
+    }
+    fprintf(TelemetryFile, "}\n");
+    fflush(TelemetryFile);
+  }
+  pthread_mutex_unlock(&StatisticsLock);
+}
+
+static void writeSummaryAtExit() {
+  pthread_mutex_lock(&StatisticsLock);
+  writeSummary();
+  pthread_mutex_unlock(&StatisticsLock);
+  if (PreviousExitHook != NULL) PreviousExitHook();
+}
+
+static void* dumpThreadStart(void* arg) {
+  sigset_t* mask = (sigset_t*)arg;
+  while (true) {
+    int signal = 0;
+    if (sigwait(mask, &signal) != 0) continue;
+    pthread_mutex_lock(&StatisticsLock);
+    writeSummary();
+    pthread_mutex_unlock(&StatisticsLock);
+  }
+  return NULL;
+}
+
+void GCStatistics::initialise() {
+  BootTime = nanoTime();
+  LastCollectionEnd = BootTime;
+  if (OutputFile == NULL) return;
 
-  result = (int64_t) tp.tv_sec;
-  result *= (int64_t)1000000L;
-  result += (int64_t)tp.tv_usec;
-  result *= (int64_t)1000;
+  TelemetryFile = fopen(OutputFile, "w");
+  if (TelemetryFile == NULL) {
+    fprintf(stderr, "Can not open %s, GC telemetry is disabled\n", OutputFile);
+    return;
+  }
+  PreviousExitHook = vmkit::System::ExitHook;
+  vmkit::System::ExitHook = writeSummaryAtExit;
 
-  return result;
+  // Threads created from now on inherit the mask, so SIGUSR1 is only
+  // received by the thread waiting for it.
+  static sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, dumpThreadStart, &mask) != 0) {
+    fprintf(stderr, "Can not create the GC telemetry thread\n");
+    return;
+  }
+  pthread_detach(thread);
+}
+
+#if defined(__linux__)
+
+struct PerfEventName {
+  const char* name;
+  uint32_t type;
+  uint64_t config;
+};
+
+// The generic events of perf_event_open, named as libpfm names them.
+static const PerfEventName KnownPerfEvents[] = {
+  { "PERF_COUNT_HW_CPU_CYCLES", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { "PERF_COUNT_HW_INSTRUCTIONS", PERF_TYPE_HARDWARE,
+    PERF_COUNT_HW_INSTRUCTIONS },
+  { "PERF_COUNT_HW_CACHE_REFERENCES", PERF_TYPE_HARDWARE,
+    PERF_COUNT_HW_CACHE_REFERENCES },
+  { "PERF_COUNT_HW_CACHE_MISSES", PERF_TYPE_HARDWARE,
+    PERF_COUNT_HW_CACHE_MISSES },
+  { "PERF_COUNT_HW_BRANCH_INSTRUCTIONS", PERF_TYPE_HARDWARE,
+    PERF_COUNT_HW_BRANCH_INSTRUCTIONS },
+  { "PERF_COUNT_HW_BRANCH_MISSES", PERF_TYPE_HARDWARE,
+    PERF_COUNT_HW_BRANCH_MISSES },
+  { "PERF_COUNT_HW_BUS_CYCLES", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BUS_CYCLES },
+  { "PERF_COUNT_SW_TASK_CLOCK", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+  { "PERF_COUNT_SW_PAGE_FAULTS", PERF_TYPE_SOFTWARE,
+    PERF_COUNT_SW_PAGE_FAULTS },
+  { "PERF_COUNT_SW_CONTEXT_SWITCHES", PERF_TYPE_SOFTWARE,
+    PERF_COUNT_SW_CONTEXT_SWITCHES },
+  { "PERF_COUNT_SW_CPU_MIGRATIONS", PERF_TYPE_SOFTWARE,
+    PERF_COUNT_SW_CPU_MIGRATIONS }
+};
+
+static void openPerfEvent(const char* name) {
+  if (NumberOfPerfEvents == MaxPerfEvents) {
+    fprintf(stderr, "Too many perf events, ignoring %s\n", name);
+    return;
+  }
+  const PerfEventName* event = NULL;
+  for (uint32_t i = 0; i < sizeof(KnownPerfEvents) / sizeof(PerfEventName); ++i) {
+    if (!strcmp(KnownPerfEvents[i].name, name)) {
+      event = &KnownPerfEvents[i];
+      break;
+    }
+  }
+  if (event == NULL) {
+    fprintf(stderr, "Unknown perf event %s\n", name);
+    return;
+  }
+
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = event->type;
+  attr.config = event->config;
+  attr.read_format =
+    PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // Count the threads created after the boot of MMTk, i.e. all mutators and
+  // collectors.
+  attr.inherit = 1;
+  int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  if (fd < 0) {
+    perror("perf_event_open");
+    return;
+  }
+  PerfEventFds[NumberOfPerfEvents] = fd;
+  PerfEventNames[NumberOfPerfEvents] = event->name;
+  ++NumberOfPerfEvents;
+}
+
+static bool readPerfEvent(uint32_t id, uint64_t* values) {
+  if (id >= NumberOfPerfEvents) return false;
+  ssize_t res = read(PerfEventFds[id], values, 3 * sizeof(uint64_t));
+  return res == 3 * sizeof(uint64_t);
+}
+
+#else
+
+static void openPerfEvent(const char* name) {
+  fprintf(stderr, "Perf events are not supported, ignoring %s\n", name);
+}
+
+static bool readPerfEvent(uint32_t id, uint64_t* values) {
+  return false;
+}
+
+#endif
+
+void GCStatistics::readCounters(uint64_t* values) {
+  for (uint32_t i = 0; i < NumberOfPerfEvents; ++i) {
+    uint64_t buffer[3];
+    if (!readPerfEvent(i, buffer)) {
+      values[i] = 0;
+    } else if (buffer[1] != buffer[2] && buffer[2] != 0) {
+      // The counter was multiplexed with other counters: scale it.
+      values[i] = (uint64_t)((double)buffer[0] * buffer[1] / buffer[2]);
+    } else {
+      values[i] = buffer[0];
+    }
+  }
+}
+
+extern "C" int64_t Java_org_j3_mmtk_Statistics_cycles__ (MMTkObject* S) {
+#if defined(__i386__) || defined(__x86_64__)
+  uint32_t low, high;
+  __asm__ __volatile__("rdtsc" : "=a" (low), "=d" (high));
+  return ((int64_t)high << 32) | low;
+#else
+  return GCStatistics::nanoTime();
+#endif
+}
+
+extern "C" int64_t Java_org_j3_mmtk_Statistics_nanoTime__ (MMTkObject* S) {
+  return GCStatistics::nanoTime();
 }
 
 
 extern "C" int32_t Java_org_j3_mmtk_Statistics_getCollectionCount__ (MMTkObject* S) {
-  return 0;
+  return GCStatistics::getCollectionCount();
 }
 
-extern "C" void Java_org_j3_mmtk_Statistics_perfEventInit__Ljava_lang_String_2(MMTkObject* S, MMTkObject* Str) {
+extern "C" void Java_org_j3_mmtk_Statistics_perfEventInit__Ljava_lang_String_2(MMTkObject* S, MMTkString* Str) {
+  if (Str == NULL || Str->count == 0) return;
+  char name[64];
+  uint32_t length = 0;
+  for (sint32 i = 0; i <= Str->count; ++i) {
+    char c = (i < Str->count) ? Str->value->elements[Str->offset + i] : ',';
+    if (c == ',') {
+      name[length] = 0;
+      if (length != 0) openPerfEvent(name);
+      length = 0;
+    } else if (length < sizeof(name) - 1) {
+      name[length++] = c;
+    }
+  }
 }
 
-extern "C" void Java_org_j3_mmtk_Statistics_perfEventRead__I_3J(MMTkObject* S, int id, int64_t* values) {
+extern "C" void Java_org_j3_mmtk_Statistics_perfEventRead__I_3J(MMTkObject* S, int id, MMTkLongArray* values) {
+  uint64_t buffer[3];
+  if (!readPerfEvent(id, buffer)) {
+    memset(buffer, 0, sizeof(buffer));
+  }
+  for (uint32_t i = 0; i < 3; ++i) values->elements[i] = buffer[i];
 }
 
 } // namespace mmtk
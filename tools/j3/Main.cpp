@@ -10,6 +10,7 @@
 #include "VmkitGC.h"
 #include "vmkit/JIT.h"
 #include "vmkit/MethodInfo.h"
+#include "vmkit/Profiler.h"
 #include "vmkit/VirtualMachine.h"
 #include "vmkit/Thread.h"
 
@@ -29,6 +30,7 @@ int main(int argc, char **argv, char **envp) {
   // Initialize base components.  
   VmkitModule::initialise(argc, argv);
   Collector::initialise(argc, argv);
+  JavaJITCompiler::initialise(argc, argv);
  
   // Create the allocator that will allocate the bootstrap loader and the JVM.
   vmkit::BumpPtrAllocator Allocator;
@@ -37,7 +39,8 @@ int main(int argc, char **argv, char **envp) {
     JnjvmBootstrapLoader(Allocator, Comp, true);
   Jnjvm* vm = new(Allocator, "VM") Jnjvm(Allocator, initialFrametables, loader);
  
-  // Run the application. 
+  // Run the application. The profile is written by System::Exit.
+  Profiler::start(vm);
   vm->runApplication(argc, argv);
   vm->waitForExit();
   System::Exit(0);